@@ -39,7 +39,11 @@ class DataLoader(object):
         backend (object):
             This is an instance of an object which knows how to create tensors
             it needs for processing, and how to transfer host information to
-            those tensors
+            those tensors.  It is called with consume_batch(buf_index,
+            host_tuple, dev_tuple) once per minibatch if it has that method,
+            otherwise with consume(buf_index, host_list, dev_list) once per
+            output.  With 'defer_transfer' in the config the call happens
+            inside next() instead of on a loader thread.
 
     Note that if the epoch is not evenly divisible by the minibatch size, there
     will be one minibatch per epoch (or so) which contains data from two
@@ -49,7 +53,6 @@ class DataLoader(object):
     def __init__(self, config, backend):
         self._config = config
 
-        self._buffer_id = 0
         self._item_index = 0
 
         self._load_library()
@@ -71,7 +74,7 @@ class DataLoader(object):
         self.loaderlib.get_error_message.restype = ct.c_char_p
         self.loaderlib.start.restype = ct.c_void_p
 
-        self.loaderlib.next.argtypes = [ct.c_void_p, ct.c_int]
+        self.loaderlib.next.argtypes = [ct.c_void_p]
         self.loaderlib.next.restype = ct.py_object
 
         self.loaderlib.shapes.argtypes = [ct.c_void_p]
@@ -82,6 +85,13 @@ class DataLoader(object):
         self.loaderlib.itemCount.argtypes = [ct.c_void_p]
         self.loaderlib.itemCount.restype = ct.c_int
 
+        self.loaderlib.stats.argtypes = [ct.c_void_p]
+        self.loaderlib.stats.restype = ct.c_char_p
+
+        self.loaderlib.get_state.argtypes = [ct.c_void_p]
+        self.loaderlib.get_state.restype = ct.c_char_p
+        self.loaderlib.set_state.argtypes = [ct.c_void_p, ct.c_char_p]
+
     def _raise_loader_error(self):
         """
         C api can't easily raise python exceptions, so it returns an error code
@@ -98,8 +108,8 @@ class DataLoader(object):
         """
         C api wrapper with exception handling
         """
-        if not hasattr(backend, 'consume'):
-            raise TypeError('backend must have a callable consume attr')
+        if not (hasattr(backend, 'consume') or hasattr(backend, 'consume_batch')):
+            raise TypeError('backend must have a callable consume or consume_batch attr')
 
         loader = self.loaderlib.start(
             ct.c_char_p(config),
@@ -128,13 +138,11 @@ class DataLoader(object):
 
         return itemCount
 
-    def _next(self, _buffer_id):
+    def _next(self):
         """
         C api wrapper with exception handling
         """
-        tup = self.loaderlib.next(
-            self.loader, ct.c_int(_buffer_id)
-        )
+        tup = self.loaderlib.next(self.loader)
 
         if tup is None:
             self._raise_loader_error()
@@ -152,6 +160,26 @@ class DataLoader(object):
 
         return ret
 
+    def stats(self):
+        """
+        Latency of each pipeline stage and occupancy of the buffer pools.
+
+        Returns a dict with 'stages', mapping each stage recorded so far to
+        its count and mean, p50, p90, p99 and max latency in microseconds,
+        'read_buffers' and 'decode_buffers', each holding how many of
+        the pool's 'count' buffers are 'used' right now, and
+        'decode_threads', how many decode threads are at work.  Latencies
+        accumulate over the life of the process.
+        """
+        ret = self.loaderlib.stats(self.loader)
+
+        if ret is None:
+            self._raise_loader_error()
+
+        if isinstance(ret, bytes):
+            ret = ret.decode('utf-8')
+        return json.loads(ret)
+
     def _reset(self):
         """
         C api wrapper with exception handling
@@ -159,6 +187,37 @@ class DataLoader(object):
         if self.loaderlib.reset(self.loader) == -1:
             self._raise_loader_error()
 
+    def get_state(self):
+        """
+        Position of the next minibatch, for a checkpoint.
+
+        Returns a json serialisable dict which set_state takes back.  It
+        holds the epoch, the block and the record in it the next minibatch
+        starts at and the state of the shuffle.
+        """
+        ret = self.loaderlib.get_state(self.loader)
+
+        if ret is None:
+            self._raise_loader_error()
+
+        if isinstance(ret, bytes):
+            ret = ret.decode('utf-8')
+        return {'loader': json.loads(ret), 'item_index': self._item_index}
+
+    def set_state(self, state):
+        """
+        Continue from a state get_state returned, with the same config.  The
+        data in between is skipped without being read.
+        """
+        ret = self.loaderlib.set_state(
+            self.loader, ct.c_char_p(json.dumps(state['loader']))
+        )
+        if ret == -1:
+            self._raise_loader_error()
+
+        self._item_index = state['item_index']
+        self._compute_nbatches()
+
     @property
     def item_count(self):
         """
@@ -177,7 +236,6 @@ class DataLoader(object):
         """
         Restart data from index 0.
         """
-        self._buffer_id = 0
         self._item_index = 0
 
         self._reset()
@@ -186,10 +244,14 @@ class DataLoader(object):
         """
         return one minibatch in a (data, targets) tuple
         """
-        dtuple = self._next(self._buffer_id)
-
-        # Toggle _buffer_id between 0 and 1
-        self._buffer_id = 1 - self._buffer_id
+        try:
+            dtuple = self._next()
+        finally:
+            # keep track of where we are in the dataset so we know which epoch we are on
+            self._item_index += self.minibatch_size
+            if self._item_index >= self.item_count:
+                self._item_index -= self.item_count
+                self._compute_nbatches()
 
         return dtuple
 
@@ -239,12 +301,6 @@ class DataLoader(object):
             except LoaderRuntimeError as e:
                 # TODO: log this somewhere instead of printing
                 print e
-            finally:
-                # keep track of where we are in the dataset so we know which epoch we are on
-                self._item_index += self.minibatch_size
-                if self._item_index >= self.item_count:
-                    self._item_index -= self.item_count
-                    self._compute_nbatches()
 
     # UNUSED
     # these are reference for how we could switch to explicit epoch handling
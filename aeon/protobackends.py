@@ -7,13 +7,17 @@ class CpuBackend(object):
         self.use_pinned_mem = False
 
     def consume(self, buf_index, hostlist, devlist):
-        assert 0 <= buf_index < 2, 'Can only double buffer'
+        assert 0 <= buf_index < len(hostlist), 'buf_index out of range'
         if devlist[buf_index] is None:
             devlist[buf_index] = np.empty_like(hostlist[buf_index].T)
         print devlist[buf_index].shape, devlist[buf_index].dtype
         print hostlist[buf_index].shape, hostlist[buf_index].dtype
         devlist[buf_index][:] = hostlist[buf_index].T
 
+    def consume_batch(self, buf_index, host_tuple, dev_tuple):
+        for hostlist, devlist in zip(host_tuple, dev_tuple):
+            self.consume(buf_index, hostlist, devlist)
+
     def get_ary(self, cpu_array):
         return cpu_array
 
@@ -28,7 +32,7 @@ class GpuBackend(object):
         self.ctx = drv.Device(device_id).make_context()
 
     def consume(self, buf_index, hostlist, devlist):
-        assert 0 <= buf_index < 2, 'Can only double buffer'
+        assert 0 <= buf_index < len(hostlist), 'buf_index out of range'
         self.ctx.push()
         hbuf = hostlist[buf_index]
         if devlist[buf_index] is None:
@@ -37,6 +41,16 @@ class GpuBackend(object):
         devlist[buf_index].set(hbuf.T)
         self.ctx.pop()
 
+    def consume_batch(self, buf_index, host_tuple, dev_tuple):
+        # one context switch for every output of the minibatch
+        self.ctx.push()
+        for hostlist, devlist in zip(host_tuple, dev_tuple):
+            hbuf = hostlist[buf_index]
+            if devlist[buf_index] is None:
+                devlist[buf_index] = GPUArray(hbuf.shape[::-1], hbuf.dtype)
+            devlist[buf_index].set(hbuf.T)
+        self.ctx.pop()
+
     def get_ary(self, gpu_array):
         self.ctx.push()
         res = gpu_array.get()
@@ -69,7 +83,7 @@ class MultiGpuBackend(object):
         self.ctxs[0].push()
 
     def consume(self, buf_index, hostlist, devlist):
-        assert 0 <= buf_index < 2, 'Can only double buffer'
+        assert 0 <= buf_index < len(hostlist), 'buf_index out of range'
         hbuf = hostlist[buf_index]
 
         frag_sz, ndims, ndtype = hbuf.shape[0] // self.num_dev, hbuf.shape[1], hbuf.dtype
@@ -2,11 +2,14 @@
 
 SRCS="
     api.cpp
+    autotune.cpp
     avi.cpp
     batch_iterator.cpp
+    block_iterator_sampled.cpp
     block_iterator_sequential.cpp
     block_iterator_shuffled.cpp
     block_loader.cpp
+    block_loader_async.cpp
     block_loader_cpio_cache.cpp
     block_loader_file.cpp
     block_loader_nds.cpp
@@ -18,6 +21,9 @@ SRCS="
     buffer_pool_out.cpp
     cap_mjpeg_decoder.cpp
     cpio.cpp
+    cpu.cpp
+    decoded_cache.cpp
+    event_count.cpp
     etl_audio.cpp
     etl_boundingbox.cpp
     etl_char_map.cpp
@@ -31,6 +37,7 @@ SRCS="
     image.cpp
     interface.cpp
     loader.cpp
+    loader_core.cpp
     log.cpp
     manifest_csv.cpp
     manifest_nds.cpp
@@ -48,6 +55,7 @@ SRCS="
     provider_video_only.cpp
     python_backend.cpp
     specgram.cpp
+    stats.cpp
     util.cpp
     wav_data.cpp
 "
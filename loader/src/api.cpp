@@ -58,10 +58,10 @@ extern int error()
     }
 }
 
-extern PyObject* next(loader* data_loader, int bufIdx)
+extern PyObject* next(loader* data_loader)
 {
     try {
-        return data_loader->next(bufIdx);
+        return data_loader->next();
     } catch(std::exception& ex) {
         last_error_message = ex.what();
 
@@ -82,6 +82,36 @@ extern PyObject* shapes(loader* data_loader)
     }
 }
 
+extern const char* stats(loader* data_loader)
+{
+    try {
+        return data_loader->stats();
+    } catch(std::exception& ex) {
+        last_error_message = ex.what();
+        return 0;
+    }
+}
+
+extern const char* get_state(loader* data_loader)
+{
+    try {
+        return data_loader->get_state();
+    } catch(std::exception& ex) {
+        last_error_message = ex.what();
+        return 0;
+    }
+}
+
+extern int set_state(loader* data_loader, const char* state)
+{
+    try {
+        return data_loader->set_state(state);
+    } catch(std::exception& ex) {
+        last_error_message = ex.what();
+        return -1;
+    }
+}
+
 extern int itemCount(loader* data_loader)
 {
     try {
@@ -24,10 +24,13 @@ static std::string last_error_message;
 extern const char* get_error_message();
 extern int error();
 extern void* start(const char* loaderConfigString, PyObject* pbackend);
-extern PyObject* next(nervana::loader* data_loader, int bufIdx);
+extern PyObject* next(nervana::loader* data_loader);
 extern int reset(nervana::loader* data_loader);
 extern int stop(nervana::loader* data_loader);
 extern int itemCount(nervana::loader* data_loader);
 extern PyObject* shapes(nervana::loader* data_loader);
+extern const char* stats(nervana::loader* data_loader);
+extern const char* get_state(nervana::loader* data_loader);
+extern int set_state(nervana::loader* data_loader, const char* state);
 
 }
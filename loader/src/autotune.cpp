@@ -0,0 +1,72 @@
+/*
+ Copyright 2016 Nervana Systems Inc.
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include <algorithm>
+
+#include "autotune.hpp"
+#include "util.hpp"
+
+using namespace std;
+using namespace nervana;
+
+namespace {
+    // fractions of the wall time.  The consumer waiting more than `busy`
+    // means the loader is the bottleneck, less than `idle` that it has
+    // capacity to spare.
+    const double busy = 0.05;
+    const double idle = 0.01;
+}
+
+autotuner::autotuner(int threads, int max_threads, int depth, int max_depth, int batches) :
+    _threads(threads),
+    _max_threads(max_threads),
+    _depth(depth),
+    _max_depth(max_depth),
+    _batches(batches)
+{
+    affirm(threads > 0 && threads <= max_threads, "autotuner threads out of range");
+    affirm(depth > 0 && depth <= max_depth, "autotuner depth out of range");
+}
+
+bool autotuner::update(uint64_t wall, uint64_t consumer_wait, uint64_t input_wait, int batches)
+{
+    if (_done || wall == 0) {
+        return !_done;
+    }
+    double waiting = double(consumer_wait) / wall;
+    double starved = double(input_wait) / wall;
+
+    if (waiting > busy) {
+        if (_lowered) {
+            // the thread given back was needed, keep it from now on
+            _threads++;
+            _min_threads = _threads;
+        } else if (starved > busy && _depth < _max_depth) {
+            _depth++;
+        } else if (_threads < _max_threads) {
+            _threads = min(_max_threads, _threads + max(1, _threads / 4));
+        }
+        _lowered = false;
+    } else if (waiting < idle && _threads > _min_threads) {
+        _threads--;
+        _lowered = true;
+    } else {
+        _lowered = false;
+    }
+
+    _seen += batches;
+    _done = _seen >= _batches;
+    return !_done;
+}
@@ -0,0 +1,57 @@
+/*
+ Copyright 2016 Nervana Systems Inc.
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+namespace nervana {
+    class autotuner;
+}
+
+/* autotuner
+ *
+ * Picks how many decode threads are active and how many read buffers are
+ * filled ahead from what the loader measured over windows of minibatches.
+ * When the consumer waits on the loader, more read buffers are allowed if
+ * the decode threads were starved of input and more threads otherwise.
+ * When it never waits, threads are given back one at a time until it does,
+ * and that step is undone.  Tuning ends after `batches` minibatches.
+ *
+ */
+class nervana::autotuner {
+public:
+    autotuner(int threads, int max_threads, int depth, int max_depth, int batches);
+
+    // takes one window of `batches` minibatches: its wall time, the time the
+    // consumer waited for minibatches and the time decoding waited for read
+    // buffers, all in ns.  Returns false once tuning is over.
+    bool update(uint64_t wall, uint64_t consumer_wait, uint64_t input_wait, int batches);
+
+    int threads() const { return _threads; }
+    int depth() const { return _depth; }
+    bool done() const { return _done; }
+
+private:
+    int     _threads;
+    int     _max_threads;
+    int     _min_threads = 1;
+    int     _depth;
+    int     _max_depth;
+    int     _batches;
+    int     _seen = 0;
+    bool    _lowered = false;
+    bool    _done = false;
+};
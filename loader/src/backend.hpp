@@ -0,0 +1,39 @@
+/*
+ Copyright 2016 Nervana Systems Inc.
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#pragma once
+
+#include "buffer_out.hpp"
+
+namespace nervana {
+    class backend;
+}
+
+/* backend
+ *
+ * Receives finished minibatches from the decode_thread_pool.
+ * call_backend_transfer is called once per minibatch, in order, with the
+ * output buffer and its index in the ring, before the buffer is handed to
+ * the reader.
+ *
+ */
+class nervana::backend {
+public:
+    virtual ~backend() {}
+
+    // whether output buffers should be allocated in page locked memory
+    virtual bool use_pinned_memory() = 0;
+    virtual void call_backend_transfer(nervana::buffer_out_array &outBuf, int bufIdx) = 0;
+};
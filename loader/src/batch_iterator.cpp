@@ -14,6 +14,7 @@
 */
 
 #include "batch_iterator.hpp"
+#include "util.hpp"
 
 using namespace nervana;
 
@@ -21,7 +22,8 @@ batch_iterator::batch_iterator(std::shared_ptr<block_iterator> src_block_iterato
                                int batch_size)
     : _src_block_iterator(src_block_iterator),
       _batch_size(batch_size),
-      _i(0)
+      _i(0),
+      _first(0)
 {
     // Note that we don't know how many buffer_ins in we will be writing to until this.read()
     // is called.  So we leave our _macrobatch buffer_in_array pointer to null until we get that
@@ -44,19 +46,47 @@ void batch_iterator::read(buffer_in_array& dst_buffer_array)
 
 void batch_iterator::reset()
 {
-    for (auto m: *_src_buffer_array_ptr) {
-        m->reset();
+    if (_src_buffer_array_ptr) {
+        for (auto m: *_src_buffer_array_ptr) {
+            m->reset();
+        }
     }
 
     _src_block_iterator->reset();
 
     _i = 0;
+    _first = 0;
+}
+
+nlohmann::json batch_iterator::get_state() const
+{
+    if (_src_buffer_array_ptr == nullptr || _i >= (*_src_buffer_array_ptr)[0]->get_item_count()) {
+        // the next record is in the next block read
+        return {{"block", _src_block_iterator->get_state()}, {"item", _first}};
+    }
+    return {{"block", _block_state}, {"item", _i}};
+}
+
+void batch_iterator::set_state(const nlohmann::json& state)
+{
+    int item = state.at("item");
+    affirm(item >= 0, "iterator state item out of range");
+    _src_block_iterator->set_state(state.at("block"));
+
+    // the block is read again by the next read, which starts at item
+    if (_src_buffer_array_ptr) {
+        for (auto m: *_src_buffer_array_ptr) {
+            m->reset();
+        }
+    }
+    _i = 0;
+    _first = item;
 }
 
 void batch_iterator::transfer_buffer_item(buffer_in* dst, buffer_in* src)
 {
     try {
-        dst->add_item(src->get_item(_i));
+        dst->add_item(*src, _i);
     } catch (std::exception& e) {
         dst->add_exception(std::current_exception());
     }
@@ -72,15 +102,18 @@ void batch_iterator::pop_item_from_block(buffer_in_array& dst_buffer_array)
             m->reset();
         }
 
+        _block_state = _src_block_iterator->get_state();
         _src_block_iterator->read(src_buffer_array);
 
-        _i = 0;
+        _i = _first;
+        _first = 0;
     }
 
     // because the _src_buffer_array_ptr Buffers may have been shuffled, and its shuffle
     // reorders the index, we can't just read a large contiguous block of
-    // memory out of the _src_buffer_array_ptr.  We must copy out each element one at
-    // a time
+    // memory out of the _src_buffer_array_ptr.  We hand over each element one at
+    // a time.  The elements are shared, not copied, and stay alive after the
+    // macroblock is reset for as long as the minibatch holds them.
     for (uint idx=0; idx < src_buffer_array.size(); ++idx) {
         transfer_buffer_item(dst_buffer_array[idx], src_buffer_array[idx]);
     }
@@ -30,6 +30,11 @@ public:
 
     void read(nervana::buffer_in_array& dst_buffer_array);
     void reset();
+
+    // the position of the next record to read: where the block holding it
+    // starts and its index in that block.  set_state only reads that block.
+    nlohmann::json get_state() const;
+    void set_state(const nlohmann::json& state);
 protected:
     void pop_item_from_block(nervana::buffer_in_array& dst_buffer_array);
     void transfer_buffer_item(nervana::buffer_in* dst, nervana::buffer_in* src);
@@ -40,4 +45,8 @@ protected:
     std::shared_ptr<nervana::buffer_in_array> _src_buffer_array_ptr;
     // the index into the _macrobatch to read next
     int _i;
+    // the index to start at in the next block read, after set_state
+    int _first;
+    // the block iterator's state before it read the current block
+    nlohmann::json _block_state;
 };
@@ -16,6 +16,7 @@
 #pragma once
 
 #include "buffer_in.hpp"
+#include "json.hpp"
 
 namespace nervana {
     class block_iterator;
@@ -26,4 +27,22 @@ class nervana::block_iterator
 public:
     virtual void read(nervana::buffer_in_array& dest) = 0;
     virtual void reset() = 0;
+
+    // the position of the next block to read, as json, and a move straight
+    // back to one.  Moving reads nothing, the blocks skipped are never loaded.
+    virtual nlohmann::json get_state() const = 0;
+    virtual void set_state(const nlohmann::json& state) = 0;
+
+protected:
+    // number the records of a block appended to dest, starting at item
+    // first, by their position in the dataset before anything reorders them
+    static void number_records(nervana::buffer_in_array& dest, int first,
+                               uint block_num, uint block_size)
+    {
+        for (auto d : dest) {
+            for (int i = first; i < d->get_item_count(); ++i) {
+                d->set_record(i, (int64_t) block_num * block_size + i - first);
+            }
+        }
+    }
 };
@@ -0,0 +1,154 @@
+/*
+ Copyright 2016 Nervana Systems Inc.
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+
+#include "block_iterator_sampled.hpp"
+#include "stats.hpp"
+#include "util.hpp"
+
+using namespace std;
+using namespace nervana;
+
+block_iterator_sampled::block_iterator_sampled(shared_ptr<block_loader> loader,
+                                               const vector<float>& weights,
+                                               uint seed)
+: _loader(loader),
+  _records(loader->shardObjectCount()),
+  _blocks(loader->shardBlockCount()),
+  _prob(_records),
+  _alias(_records),
+  _seed(seed),
+  _epoch(0),
+  _block(0)
+{
+    affirm(weights.size() == _loader->objectCount(), "there must be a weight for every record");
+
+    // Vose's alias method.  Every entry of the table holds a share 1/n of
+    // the total weight: _prob[i] of it for record i and the rest for
+    // record _alias[i].
+    vector<double> scaled(_records);
+    double total = 0;
+    for (uint i = 0; i < _records; ++i) {
+        float w = weights[record(i)];
+        affirm(w >= 0 && std::isfinite(w), "record weights must be finite and not negative");
+        scaled[i] = w;
+        total += w;
+    }
+    affirm(total > 0, "record weights are all zero");
+
+    vector<uint> small, large;
+    for (uint i = 0; i < _records; ++i) {
+        scaled[i] *= _records / total;
+        (scaled[i] < 1 ? small : large).push_back(i);
+    }
+    while (!small.empty() && !large.empty()) {
+        uint s = small.back();
+        uint l = large.back();
+        small.pop_back();
+        _prob[s] = scaled[s];
+        _alias[s] = l;
+        scaled[l] -= 1 - scaled[s];
+        if (scaled[l] < 1) {
+            large.pop_back();
+            small.push_back(l);
+        }
+    }
+    // what is left is 1 give or take rounding
+    for (uint i : large) {
+        _prob[i] = 1;
+        _alias[i] = i;
+    }
+    for (uint i : small) {
+        _prob[i] = 1;
+        _alias[i] = i;
+    }
+}
+
+vector<float> block_iterator_sampled::balanced(const vector<string>& classes)
+{
+    map<string, uint> counts;
+    for (auto& c : classes) {
+        ++counts[c];
+    }
+    vector<float> weights;
+    weights.reserve(classes.size());
+    for (auto& c : classes) {
+        weights.push_back(1.0f / counts[c]);
+    }
+    return weights;
+}
+
+int64_t block_iterator_sampled::record(uint i)
+{
+    uint block_size = _loader->blockSize();
+    return (int64_t)_loader->shardBlock(i / block_size) * block_size + i % block_size;
+}
+
+uint block_iterator_sampled::draw(mt19937& rand)
+{
+    uint i = uniform_int_distribution<uint>(0, _records - 1)(rand);
+    return uniform_real_distribution<float>(0, 1)(rand) < _prob[i] ? i : _alias[i];
+}
+
+void block_iterator_sampled::read(nervana::buffer_in_array& dest)
+{
+    // the draws of a block depend only on the seed, the epoch and the
+    // block, so a state needs nothing else
+    seed_seq mix{_seed, _epoch, _block};
+    mt19937 rand(mix);
+
+    uint block_size = _loader->blockSize();
+    uint count = _block + 1 < _blocks ? block_size : _records - _block * block_size;
+    {
+        stats::timer timer(stats::stage::block_read);
+        for (uint n = 0; n < count; ++n) {
+            int64_t r = record(draw(rand));
+            int first = dest.size() > 0 ? dest[0]->get_item_count() : 0;
+            _loader->loadRecord(dest, r);
+            for (auto d : dest) {
+                d->set_record(first, r);
+            }
+        }
+    }
+
+    if (++_block == _blocks) {
+        _block = 0;
+        ++_epoch;
+    }
+}
+
+void block_iterator_sampled::reset()
+{
+    _block = 0;
+    ++_epoch;
+}
+
+nlohmann::json block_iterator_sampled::get_state() const
+{
+    return {{"epoch", _epoch}, {"block", _block}, {"blocks", _blocks}, {"seed", _seed}};
+}
+
+void block_iterator_sampled::set_state(const nlohmann::json& state)
+{
+    affirm(state.at("blocks").get<uint>() == _blocks && state.at("seed").get<uint>() == _seed,
+           "iterator state is for a different dataset or seed");
+    uint block = state.at("block");
+    affirm(block < _blocks, "iterator state block out of range");
+    _block = block;
+    _epoch = state.at("epoch");
+}
@@ -0,0 +1,66 @@
+/*
+ Copyright 2016 Nervana Systems Inc.
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#pragma once
+#include <random>
+#include <vector>
+#include "block_loader.hpp"
+#include "block_iterator.hpp"
+
+namespace nervana {
+    class block_iterator_sampled;
+}
+
+/* block_iterator_sampled
+ *
+ * Draws records with replacement, each with a chance in proportion to its
+ * weight, instead of reading blocks in turn.  `weights` has one entry per
+ * record of the dataset.  An epoch is as many draws as the loader's shard
+ * has records, handed out in blocks of the loader's block size, and only
+ * the shard's records are drawn.
+ *
+ * Draws use an alias table, so each takes constant time and the table
+ * holds a probability and an alias per record.  Records are read one at a
+ * time with the loader's loadRecord, through its cache if it has one,
+ * which fills in the cache a whole block at a time.
+ */
+class nervana::block_iterator_sampled : public block_iterator {
+public:
+    block_iterator_sampled(std::shared_ptr<block_loader> loader,
+                           const std::vector<float>& weights,
+                           uint seed);
+    void read(nervana::buffer_in_array& dest);
+    void reset();
+    nlohmann::json get_state() const;
+    void set_state(const nlohmann::json& state);
+
+    // weights that draw every class equally often, for records labelled
+    // with `classes`
+    static std::vector<float> balanced(const std::vector<std::string>& classes);
+
+private:
+    // the dataset's number for the shard's ith record
+    int64_t record(uint i);
+    uint draw(std::mt19937& rand);
+
+    std::shared_ptr<block_loader> _loader;
+    uint _records;
+    uint _blocks;
+    std::vector<float> _prob;
+    std::vector<uint> _alias;
+    uint _seed;
+    uint _epoch;
+    uint _block;
+};
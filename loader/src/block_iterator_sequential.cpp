@@ -13,13 +13,17 @@
  limitations under the License.
 */
 
+#include <algorithm>
+
 #include "block_iterator_sequential.hpp"
+#include "stats.hpp"
+#include "util.hpp"
 
 using namespace std;
 using namespace nervana;
 
 block_iterator_sequential::block_iterator_sequential(shared_ptr<block_loader> loader)
-: _loader(loader), _count(_loader->blockCount()), _i(0)
+: _loader(loader), _count(_loader->shardBlockCount()), _i(0), _epoch(0), _primed(false)
 {
 }
 
@@ -31,13 +35,54 @@ void block_iterator_sequential::read(nervana::buffer_in_array& dest)
     // exceptions, there is no retry logic.
     auto i = _i;
     if (++_i == _count) {
-        reset();
+        _i = 0;
+        ++_epoch;
     }
 
-    _loader->loadBlock(dest, i);
+    // a sharded loader's blocks are every shardCount()'th of the dataset
+    uint block = _loader->shardBlock(i);
+    prefetch(i);
+    int first = dest.size() > 0 ? dest[0]->get_item_count() : 0;
+    {
+        stats::timer timer(stats::stage::block_read);
+        _loader->loadBlock(dest, block);
+    }
+    number_records(dest, first, block, _loader->blockSize());
 }
 
 void block_iterator_sequential::reset()
 {
     _i = 0;
+    ++_epoch;
+    _primed = false;
+}
+
+nlohmann::json block_iterator_sequential::get_state() const
+{
+    return {{"epoch", _epoch}, {"block", _i}, {"blocks", _count}};
+}
+
+void block_iterator_sequential::set_state(const nlohmann::json& state)
+{
+    affirm(state.at("blocks").get<uint>() == _count, "iterator state is for a different dataset");
+    uint block = state.at("block");
+    affirm(block < _count, "iterator state block out of range");
+    _i = block;
+    _epoch = state.at("epoch");
+    _primed = false;
+}
+
+void block_iterator_sequential::prefetch(uint i)
+{
+    // the first read after a reset announces the whole window, after that
+    // each read only needs to announce the block entering it.  The window
+    // is kept shorter than an epoch so a block is never in it twice.
+    uint depth = min(_loader->prefetchDepth(), _count - 1);
+    if (depth == 0) {
+        return;
+    }
+    for (uint ahead = _primed ? depth : 0; ahead <= depth; ++ahead) {
+        _loader->prefetch(_loader->shardBlock((i + ahead) % _count));
+    }
+    _primed = true;
 }
@@ -27,9 +27,15 @@ public:
     block_iterator_sequential(std::shared_ptr<block_loader> loader);
     void read(nervana::buffer_in_array& dest);
     void reset();
+    nlohmann::json get_state() const;
+    void set_state(const nlohmann::json& state);
 
 private:
+    void prefetch(uint i);
+
     std::shared_ptr<block_loader> _loader;
     uint _count;
     uint _i;
+    uint _epoch;
+    bool _primed;
 };
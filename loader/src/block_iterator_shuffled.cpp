@@ -16,50 +16,150 @@
 #include <vector>
 #include <algorithm>
 #include <random>
+#include <sstream>
 
 #include "block_iterator_shuffled.hpp"
+#include "stats.hpp"
+#include "util.hpp"
 
 using namespace std;
 using namespace nervana;
 
-block_iterator_shuffled::block_iterator_shuffled(shared_ptr<block_loader> loader, uint seed)
-: _rand(seed), _loader(loader), _seed(seed), _epoch(0)
+block_iterator_shuffled::block_iterator_shuffled(shared_ptr<block_loader> loader, uint seed,
+                                                 uint window)
+: _rand(seed), _loader(loader), _seed(seed), _window(window), _epoch(0), _primed(false)
+{
+    affirm(_window > 0, "shuffle window must be at least one block");
+    first_epoch();
+}
+
+void block_iterator_shuffled::first_epoch()
 {
     // fill indices with integers from  0 to _count.  indices can then be
     // shuffled and used to iterate randomly through the blocks.
-    _indices.resize(_loader->blockCount());
-    iota(_indices.begin(), _indices.end(), 0);
+    _rand.seed(_seed);
+    _order.resize(_loader->blockCount());
+    iota(_order.begin(), _order.end(), 0);
+    shuffle();
+    _indices = _next_indices;
     shuffle();
     _it = _indices.begin();
+    _epoch = 0;
 }
 
 void block_iterator_shuffled::shuffle()
 {
-    std::shuffle(_indices.begin(), _indices.end(), _rand);
+    std::shuffle(_order.begin(), _order.end(), _rand);
+    _next_indices.clear();
+    // with equal shards a shard leaves out the dataset's partial block and
+    // its full blocks past the count, different ones every epoch
+    uint count = _loader->shardBlockCount();
+    for (uint block : _order) {
+        if (_next_indices.size() < count && _loader->inShard(block) &&
+            (!_loader->equalShards() || _loader->fullBlock(block))) {
+            _next_indices.push_back(block);
+        }
+    }
 }
 
 void block_iterator_shuffled::read(nervana::buffer_in_array &dest)
 {
-    _loader->loadBlock(dest, *_it);
+    // read a window of up to _window blocks, which stops at the end of the
+    // epoch, and shuffle their records together
+    uint window_start = *_it;
+    uint epoch = _epoch;
+    for (uint i = 0; i < _window && _epoch == epoch; ++i) {
+        prefetch();
+        int first = dest.size() > 0 ? dest[0]->get_item_count() : 0;
+        {
+            stats::timer timer(stats::stage::block_read);
+            _loader->loadBlock(dest, *_it);
+        }
+        number_records(dest, first, *_it, _loader->blockSize());
+
+        if(++_it == _indices.end()) {
+            next_epoch();
+        }
+    }
 
     // shuffle the objects in BufferPair dest
-    // seed the shuffle with the seed passed in the constructor + the _epoch
-    // to ensure that the buffer shuffles are deterministic wrt the input seed.
+    // seed the shuffle with the seed passed in the constructor, the epoch
+    // and the window's first block to ensure that the buffer shuffles are
+    // deterministic wrt the input seed but differ from window to window.
     // HACK: pass the same seed to both shuffles to ensure that both buffers
     // are shuffled in the same order.
-
+    seed_seq mix{_seed, epoch, window_start};
+    uint seed;
+    mix.generate(&seed, &seed + 1);
     for (auto d: dest) {
-        d->shuffle(_seed + _epoch);
+        d->shuffle(seed);
     }
+}
+
+void block_iterator_shuffled::reset()
+{
+    next_epoch();
+    _primed = false;
+}
+
+nlohmann::json block_iterator_shuffled::get_state() const
+{
+    stringstream rand;
+    rand << _rand;
+    return {{"epoch", _epoch},
+            {"block", _it - _indices.begin()},
+            {"blocks", _indices.size()},
+            {"seed", _seed},
+            {"window", _window},
+            {"rand", rand.str()}};
+}
+
+void block_iterator_shuffled::set_state(const nlohmann::json& state)
+{
+    affirm(state.at("blocks").get<size_t>() == _indices.size() &&
+           state.at("seed").get<uint>() == _seed &&
+           state.at("window").get<uint>() == _window,
+           "iterator state is for a different dataset, seed or shuffle window");
+    uint epoch = state.at("epoch");
+    uint block = state.at("block");
+    affirm(block < _indices.size(), "iterator state block out of range");
 
-    if(++_it == _indices.end()) {
-        reset();
+    // each epoch's block order is shuffled from the one before, so the
+    // orders are rebuilt by replaying the shuffles.  That only touches the
+    // indices, no block is read.
+    first_epoch();
+    while (_epoch < epoch) {
+        next_epoch();
     }
+    stringstream rand;
+    rand << _rand;
+    affirm(rand.str() == state.at("rand").get<string>(), "iterator state random generator doesn't match");
+    _it = _indices.begin() + block;
+    _primed = false;
 }
 
-void block_iterator_shuffled::reset()
+void block_iterator_shuffled::next_epoch()
 {
+    _indices = _next_indices;
     shuffle();
     _it = _indices.begin();
     ++_epoch;
 }
+
+void block_iterator_shuffled::prefetch()
+{
+    // announce the block about to be read and the ones following it,
+    // continuing into the next epoch's order when the window runs past
+    // the end of this one
+    uint count = _indices.size();
+    uint depth = min(_loader->prefetchDepth(), count - 1);
+    if (depth == 0) {
+        return;
+    }
+    uint pos = _it - _indices.begin();
+    for (uint ahead = _primed ? depth : 0; ahead <= depth; ++ahead) {
+        uint i = pos + ahead;
+        _loader->prefetch(i < count ? _indices[i] : _next_indices[i - count]);
+    }
+    _primed = true;
+}
@@ -23,21 +23,41 @@ namespace nervana {
 }
 
 // This batch iterator shuffles the order that macro blocks are used as
-// well as shuffling the data in the buffers.
+// well as shuffling the data in the buffers.  The order is drawn for every
+// block of the dataset, so shards given the same seed agree on it and each
+// reads its own blocks in the order they have there.
+//
+// Records are shuffled within a window of `window` blocks read together,
+// so they mix with records from other blocks.  Wider windows mix better at
+// the cost of holding more blocks in memory, and the blocks are still read
+// whole and one after another.
 class nervana::block_iterator_shuffled : public block_iterator {
 public:
-    block_iterator_shuffled(std::shared_ptr<block_loader> loader, uint seed);
+    block_iterator_shuffled(std::shared_ptr<block_loader> loader, uint seed, uint window = 1);
     void read(nervana::buffer_in_array& dest);
     void reset();
+    nlohmann::json get_state() const;
+    void set_state(const nlohmann::json& state);
 
 protected:
+    void first_epoch();
     void shuffle();
+    void next_epoch();
+    void prefetch();
 
 private:
     std::minstd_rand0 _rand;
     std::shared_ptr<block_loader> _loader;
+    // block order of the whole dataset in the following epoch
+    std::vector<uint> _order;
+    // the loader's blocks in this epoch's order
     std::vector<uint> _indices;
+    // block order of the following epoch, drawn one epoch early so that
+    // prefetching can look past the end of the current one
+    std::vector<uint> _next_indices;
     std::vector<uint>::iterator _it;
     uint _seed;
+    uint _window;
     uint _epoch;
+    bool _primed;
 };
@@ -22,9 +22,23 @@
 using namespace std;
 using namespace nervana;
 
-block_loader::block_loader(uint block_size)
-: _block_size(block_size)
-{}
+block_loader::block_loader(uint block_size, uint shard_count, uint shard_index, bool equal_shards)
+: _block_size(block_size), _shard_count(shard_count), _shard_index(shard_index),
+  _equal_shards(equal_shards && shard_count > 1)
+{
+    affirm(shard_index < shard_count, "shard index must be less then shard count");
+}
+
+void block_loader::loadRecord(buffer_in_array& dest, uint64_t record)
+{
+    buffer_in_array block(dest.size());
+    loadBlock(block, record / _block_size);
+    int index = record % _block_size;
+    affirm(block.size() == 0 || index < block[0]->get_item_count(), "record outside its block");
+    for (uint i = 0; i < dest.size(); ++i) {
+        dest[i]->add_item(*block[i], index);
+    }
+}
 
 uint block_loader::blockSize()
 {
@@ -36,8 +50,32 @@ uint block_loader::blockCount()
     return ceil((float)objectCount() / (float)_block_size);
 }
 
-block_loader_alphabet::block_loader_alphabet(uint block_size) :
-    block_loader(block_size)
+uint block_loader::shardBlockCount()
+{
+    if (_equal_shards) {
+        return objectCount() / _block_size / _shard_count;
+    }
+    uint count = blockCount();
+    return count > _shard_index ? (count - _shard_index - 1) / _shard_count + 1 : 0;
+}
+
+uint block_loader::shardObjectCount()
+{
+    // every block is full but the dataset's last
+    uint blocks = shardBlockCount();
+    if (_equal_shards) {
+        return blocks * _block_size;
+    }
+    uint count = blocks * _block_size;
+    if (blocks > 0 && inShard(blockCount() - 1)) {
+        count -= blockCount() * _block_size - objectCount();
+    }
+    return count;
+}
+
+block_loader_alphabet::block_loader_alphabet(uint block_size, uint shard_count, uint shard_index,
+                                             bool equal_shards) :
+    block_loader(block_size, shard_count, shard_index, equal_shards)
 {
     affirm(block_size < 26, "block_loader_alphabet block_size must be < 26");
 }
@@ -29,22 +29,59 @@ namespace nervana {
 
 class nervana::block_loader {
 public:
+    virtual ~block_loader() {}
     virtual void loadBlock(nervana::buffer_in_array& dest, uint block_num) = 0;
     virtual uint objectCount() = 0;
 
+    // appends record `record` of the dataset to dest.  Unless a loader
+    // can read records on their own this loads the record's whole block
+    // and keeps just the one.
+    virtual void loadRecord(nervana::buffer_in_array& dest, uint64_t record);
+
+    // prefetch is a hint that block_num will be requested by loadBlock soon.
+    // Block iterators hint the block they are about to read and up to
+    // prefetchDepth() blocks after it, in the order they will be read.
+    // Loaders which don't read ahead ignore the hints.
+    virtual void prefetch(uint block_num) {}
+    virtual uint prefetchDepth() { return 0; }
+
     uint blockCount();
     uint blockSize();
 
+    // A sharded loader is one of shardCount(), reading every shardCount()'th
+    // block of the dataset from shardIndex() on.  Blocks keep their numbers
+    // in the whole dataset, so the shards agree on them and can share a
+    // cache.  shardBlock(i) is the number of the shard's ith block.
+    //
+    // Shards differ by a block when the blocks don't divide evenly, and
+    // the one with the dataset's last block is shorter again.  With
+    // equalShards() every shard drops the remainder instead and reads the
+    // same number of full blocks each epoch, so data parallel workers
+    // agree on the length of an epoch.
+    uint shardCount() { return _shard_count; }
+    uint shardIndex() { return _shard_index; }
+    bool equalShards() { return _equal_shards; }
+    bool inShard(uint block_num) { return block_num % _shard_count == _shard_index; }
+    bool fullBlock(uint block_num) { return (block_num + 1) * _block_size <= objectCount(); }
+    uint shardBlock(uint i) { return i * _shard_count + _shard_index; }
+    uint shardBlockCount();
+    uint shardObjectCount();
+
 protected:
-    block_loader(uint block_size);
+    block_loader(uint block_size, uint shard_count = 1, uint shard_index = 0,
+                 bool equal_shards = false);
     uint _block_size;
+    uint _shard_count;
+    uint _shard_index;
+    bool _equal_shards;
 };
 
 
 // mock alphabet block loader for use in tests
 class nervana::block_loader_alphabet : public block_loader {
 public:
-    block_loader_alphabet(uint block_size);
+    block_loader_alphabet(uint block_size, uint shard_count = 1, uint shard_index = 0,
+                          bool equal_shards = false);
     void loadBlock(nervana::buffer_in_array &dest, uint block_num);
     uint objectCount() { return 26 * _block_size; }
 };
@@ -0,0 +1,173 @@
+/*
+ Copyright 2016 Nervana Systems Inc.
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include <algorithm>
+
+#include "block_loader_async.hpp"
+#include "cpu.hpp"
+#include "util.hpp"
+
+using namespace std;
+using namespace nervana;
+
+block_loader_async::block_loader_async(shared_ptr<block_loader> loader,
+                                       uint thread_count,
+                                       uint depth,
+                                       const vector<int>& cpus)
+: block_loader(loader->blockSize(), loader->shardCount(), loader->shardIndex(),
+               loader->equalShards()),
+  _loader(loader),
+  _depth(depth)
+{
+    affirm(thread_count > 0, "block_loader_async thread_count must be > 0");
+
+    for (uint i = 0; i < thread_count; ++i) {
+        _threads.emplace_back(&block_loader_async::run, this);
+        cpu::pin(_threads.back(), cpus);
+    }
+}
+
+block_loader_async::~block_loader_async()
+{
+    {
+        lock_guard<mutex> lock(_mutex);
+        _stop = true;
+    }
+    _work.notify_all();
+    for (auto& t : _threads) {
+        t.join();
+    }
+}
+
+void block_loader_async::prefetch(uint block_num)
+{
+    {
+        lock_guard<mutex> lock(_mutex);
+        // the block being read plus `depth` blocks ahead of it
+        if (_requests.size() > _depth) {
+            return;
+        }
+
+        auto r = make_shared<request>(block_num);
+        _requests.push_back(r);
+        _pending.push_back(r);
+    }
+    _work.notify_one();
+}
+
+uint block_loader_async::prefetchDepth()
+{
+    return _depth;
+}
+
+void block_loader_async::loadBlock(buffer_in_array& dest, uint block_num)
+{
+    shared_ptr<request> r;
+    {
+        unique_lock<mutex> lock(_mutex);
+        if (_nbuffers == 0) {
+            // reader threads can't allocate buffers until they know how
+            // many elements a record has
+            _nbuffers = dest.size();
+            _work.notify_all();
+        }
+
+        auto it = find_if(_requests.begin(), _requests.end(),
+                          [block_num](const shared_ptr<request>& x) {
+                              return x->block_num == block_num;
+                          });
+
+        if (it != _requests.end()) {
+            // anything hinted before this block has been skipped by the
+            // iterator (reset or a failed read) and is no longer wanted
+            for (auto skipped = _requests.begin(); skipped != it; ++skipped) {
+                (*skipped)->cancelled = true;
+            }
+            r = *it;
+            _requests.erase(_requests.begin(), it + 1);
+
+            while (r->done == false) {
+                _done.wait(lock);
+            }
+        } else {
+            // the iterator went somewhere it didn't announce, so none of
+            // the outstanding hints can be trusted any more
+            for (auto& skipped : _requests) {
+                skipped->cancelled = true;
+            }
+            _requests.clear();
+        }
+    }
+
+    if (r == nullptr) {
+        _loader->loadBlock(dest, block_num);
+        return;
+    }
+
+    if (r->error) {
+        rethrow_exception(r->error);
+    }
+
+    for (uint i = 0; i < dest.size(); ++i) {
+        dest[i]->append(*(*r->data)[i]);
+    }
+}
+
+void block_loader_async::loadRecord(buffer_in_array& dest, uint64_t record)
+{
+    _loader->loadRecord(dest, record);
+}
+
+uint block_loader_async::objectCount()
+{
+    return _loader->objectCount();
+}
+
+void block_loader_async::run()
+{
+    while (true) {
+        shared_ptr<request> r;
+        uint nbuffers;
+        {
+            unique_lock<mutex> lock(_mutex);
+            while (_stop == false && (_nbuffers == 0 || _pending.empty())) {
+                _work.wait(lock);
+            }
+            if (_stop) {
+                return;
+            }
+            r = _pending.front();
+            _pending.pop_front();
+            if (r->cancelled) {
+                continue;
+            }
+            nbuffers = _nbuffers;
+        }
+
+        auto data = make_shared<buffer_in_array>(nbuffers);
+        try {
+            _loader->loadBlock(*data, r->block_num);
+        } catch (std::exception&) {
+            r->error = current_exception();
+        }
+
+        {
+            lock_guard<mutex> lock(_mutex);
+            r->data = data;
+            r->done = true;
+        }
+        _done.notify_all();
+    }
+}
@@ -0,0 +1,84 @@
+/*
+ Copyright 2016 Nervana Systems Inc.
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#pragma once
+
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "block_loader.hpp"
+
+/* block_loader_async
+ *
+ * Wraps another block_loader and reads blocks with `thread_count` threads.
+ * Block iterators announce the blocks they are about to read through
+ * prefetch(), keeping up to `depth` blocks in flight.  loadBlock hands
+ * blocks out in the order they are requested, so the block order seen by
+ * the caller is the same as with the wrapped loader alone.  The reader
+ * threads are restricted to `cpus` when it is not empty.
+ *
+ * The wrapped loader must tolerate concurrent loadBlock calls for
+ * different block numbers.
+ */
+
+namespace nervana {
+    class block_loader_async;
+}
+
+class nervana::block_loader_async : public block_loader {
+public:
+    block_loader_async(std::shared_ptr<block_loader> loader, uint thread_count, uint depth,
+                       const std::vector<int>& cpus = std::vector<int>());
+    ~block_loader_async();
+
+    void loadBlock(nervana::buffer_in_array& dest, uint block_num) override;
+    // records aren't announced, they are read straight from the wrapped loader
+    void loadRecord(nervana::buffer_in_array& dest, uint64_t record) override;
+    uint objectCount() override;
+
+    void prefetch(uint block_num) override;
+    uint prefetchDepth() override;
+
+private:
+    class request {
+    public:
+        request(uint num) : block_num(num) {}
+
+        uint                                block_num;
+        std::shared_ptr<buffer_in_array>    data;
+        std::exception_ptr                  error;
+        bool                                done      = false;
+        bool                                cancelled = false;
+    };
+
+    void run();
+
+    std::shared_ptr<block_loader>           _loader;
+    uint                                    _depth;
+    uint                                    _nbuffers = 0;
+    bool                                    _stop     = false;
+
+    // every request which has not been handed out yet, in the order it was
+    // hinted.  _pending holds the subset no reader thread has picked up.
+    std::deque<std::shared_ptr<request>>    _requests;
+    std::deque<std::shared_ptr<request>>    _pending;
+
+    std::mutex                              _mutex;
+    std::condition_variable                 _work;
+    std::condition_variable                 _done;
+    std::vector<std::thread>                _threads;
+};
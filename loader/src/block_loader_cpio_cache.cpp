@@ -19,9 +19,23 @@
 #include <unistd.h>
 #include <stdio.h>
 #include <ftw.h>
+#include <fcntl.h>
+#include <ctype.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <map>
+#include <fstream>
+#include <algorithm>
 
 #include "cpio.hpp"
 #include "block_loader_cpio_cache.hpp"
+#include "util.hpp"
 
 using namespace std;
 using namespace nervana;
@@ -29,17 +43,463 @@ using namespace nervana;
 // maximum number of files opened by nftw file enumeration function
 #define OPEN_MAX 128
 
+/* file_lock
+ *
+ * Holds an exclusive flock on a file for as long as it is in scope, so
+ * processes sharing a cache root take turns updating its index.
+ */
+
+namespace {
+    class file_lock {
+    public:
+        file_lock(const string& filename) :
+            _fd(open(filename.c_str(), O_RDWR | O_CREAT, 0666))
+        {
+            if (_fd < 0) {
+                throw std::runtime_error("error opening " + filename + " " + strerror(errno));
+            }
+            while (flock(_fd, LOCK_EX) != 0) {
+                if (errno != EINTR) {
+                    int error = errno;
+                    close(_fd);
+                    throw std::runtime_error("error locking " + filename + " " + strerror(error));
+                }
+            }
+        }
+
+        ~file_lock()
+        {
+            close(_fd);
+        }
+
+    private:
+        int _fd;
+    };
+
+    bool is_block_file(const string& name)
+    {
+        // <block_num>-<block_size>.cpio, as written by blockFilename
+        size_t dash = name.find('-');
+        if (dash == 0 || dash == string::npos || name.size() < 5 ||
+            name.compare(name.size() - 5, 5, ".cpio") != 0) {
+            return false;
+        }
+        for (size_t i = 0; i < name.size() - 5; i++) {
+            if (i != dash && !isdigit(name[i])) {
+                return false;
+            }
+        }
+        return dash + 1 < name.size() - 5;
+    }
+}
+
+/* cache_index
+ *
+ * Tracks the size and use of every block file under the cache root, across
+ * all of the cache directories in it, least recently used first, and
+ * removes files from the front when they add up to more than maxBytes.
+ *
+ * Each cache keeps its own copy of the order and evicts from it as blocks
+ * are added.  Every syncInterval uses, and when the cache is destroyed, it
+ * merges with the index file at the root under a file lock: the files on
+ * disk, oldest first, then the order other processes saved, then the uses
+ * seen here since the last merge.  Between merges, blocks other processes
+ * added aren't counted against the budget.
+ */
+
+class block_loader_cpio_cache::cache_index {
+public:
+    cache_index(const string& root, size_t maxBytes) :
+        _root(root),
+        _indexFilename(root + "/index"),
+        _lockFilename(root + "/index.lock"),
+        _maxBytes(maxBytes),
+        _totalBytes(0)
+    {
+        sync();
+    }
+
+    ~cache_index()
+    {
+        try {
+            lock_guard<mutex> lock(_mutex);
+            sync();
+        } catch (std::exception& e) {
+            cerr << "ERROR saving cache index: " << e.what() << endl;
+        }
+    }
+
+    void touch(const string& filename)
+    {
+        lock_guard<mutex> lock(_mutex);
+        string name = relative(filename);
+        auto it = _files.find(name);
+        if (it != _files.end()) {
+            _lru.splice(_lru.end(), _lru, it->second);
+        }
+        used(name);
+    }
+
+    void add(const string& filename)
+    {
+        struct stat stats;
+        if (stat(filename.c_str(), &stats) != 0) {
+            return;
+        }
+
+        lock_guard<mutex> lock(_mutex);
+        string name = relative(filename);
+        remove(name);
+        insert(name, stats.st_size);
+        evict(name);
+        used(name);
+    }
+
+private:
+    class entry {
+    public:
+        string  filename;
+        size_t  size;
+    };
+
+    static const size_t syncInterval = 256;
+
+    string relative(const string& filename)
+    {
+        return filename.substr(_root.size() + 1);
+    }
+
+    void used(const string& name)
+    {
+        _used.push_back(name);
+        if (_used.size() >= syncInterval) {
+            sync();
+        }
+    }
+
+    void insert(const string& filename, size_t size)
+    {
+        _files[filename] = _lru.insert(_lru.end(), {filename, size});
+        _totalBytes += size;
+    }
+
+    void remove(const string& filename)
+    {
+        auto it = _files.find(filename);
+        if (it != _files.end()) {
+            _totalBytes -= it->second->size;
+            _lru.erase(it->second);
+            _files.erase(it);
+        }
+    }
+
+    void evict(const string& keep)
+    {
+        // never remove the file that was just added, even if it alone is
+        // larger than the budget
+        while (_totalBytes > _maxBytes && !_lru.empty() && _lru.front().filename != keep) {
+            string filename = _lru.front().filename;
+            unlink((_root + "/" + filename).c_str());
+            remove(filename);
+        }
+    }
+
+    void sync()
+    {
+        file_lock lock(_lockFilename);
+
+        _lru.clear();
+        _files.clear();
+        _totalBytes = 0;
+        scan();
+
+        // move what the index lists to the back in the order it was used,
+        // then what was used here since the last sync
+        ifstream in(_indexFilename);
+        string name;
+        while (in >> name) {
+            moveToBack(name);
+        }
+        for (auto& name : _used) {
+            moveToBack(name);
+        }
+        _used.clear();
+
+        evict(_lru.empty() ? "" : _lru.back().filename);
+        save();
+    }
+
+    void moveToBack(const string& name)
+    {
+        auto it = _files.find(name);
+        if (it != _files.end()) {
+            _lru.splice(_lru.end(), _lru, it->second);
+        }
+    }
+
+    void scan()
+    {
+        // every block file in every cache directory under the root, oldest first
+        vector<pair<time_t, entry>> found;
+        DIR* root = opendir(_root.c_str());
+        if (root == NULL) {
+            throw std::runtime_error("error enumerating cache in " + _root);
+        }
+        struct dirent* ent;
+        while ((ent = readdir(root)) != NULL) {
+            string cache = ent->d_name;
+            struct stat stats;
+            if (cache == "." || cache == ".." ||
+                stat((_root + "/" + cache).c_str(), &stats) != 0 || !S_ISDIR(stats.st_mode)) {
+                continue;
+            }
+            DIR* dir = opendir((_root + "/" + cache).c_str());
+            if (dir == NULL) {
+                continue;
+            }
+            struct dirent* file;
+            while ((file = readdir(dir)) != NULL) {
+                string name = cache + "/" + file->d_name;
+                if (is_block_file(file->d_name) && stat((_root + "/" + name).c_str(), &stats) == 0) {
+                    found.push_back({stats.st_mtime, {name, (size_t) stats.st_size}});
+                }
+            }
+            closedir(dir);
+        }
+        closedir(root);
+        sort(found.begin(), found.end(), [](const pair<time_t, entry>& a, const pair<time_t, entry>& b) {
+            return a.first < b.first;
+        });
+        for (auto& f : found) {
+            insert(f.second.filename, f.second.size);
+        }
+    }
+
+    void save()
+    {
+        string temp = _indexFilename + ".tmp";
+        {
+            ofstream out(temp);
+            for (auto& e : _lru) {
+                out << e.filename << "\n";
+            }
+            if (!out) {
+                throw std::runtime_error("error writing " + temp);
+            }
+        }
+        if (rename(temp.c_str(), _indexFilename.c_str()) != 0) {
+            throw std::runtime_error("error writing " + _indexFilename + " " + strerror(errno));
+        }
+    }
+
+    const string                        _root;
+    const string                        _indexFilename;
+    const string                        _lockFilename;
+    const size_t                        _maxBytes;
+    size_t                              _totalBytes;
+    list<entry>                         _lru;
+    map<string, list<entry>::iterator>  _files;
+    vector<string>                      _used;
+    mutex                               _mutex;
+};
+
+/* write_queue
+ *
+ * Blocks waiting to be written to the cache and the thread writing them.
+ * The destructor finishes writing everything that was queued.
+ */
+
+class block_loader_cpio_cache::write_queue {
+public:
+    write_queue(size_t maxBytes, const shared_ptr<cache_index>& index) :
+        _maxBytes(maxBytes),
+        _index(index),
+        _queuedBytes(0),
+        _stop(false),
+        _writer(&write_queue::run, this)
+    {
+    }
+
+    ~write_queue()
+    {
+        {
+            lock_guard<mutex> lock(_mutex);
+            _stop = true;
+        }
+        _changed.notify_all();
+        _writer.join();
+    }
+
+    void push(buffer_in_array& src, uint block_num, const string& filename)
+    {
+        // share src's items rather than copying them.  This throws, and
+        // the block isn't cached, if any item holds an exception.
+        shared_ptr<buffer_in_array> data = make_shared<buffer_in_array>(src.size());
+        size_t bytes = 0;
+        for (size_t i = 0; i < src.size(); i++) {
+            for (int j = 0; j < src[i]->get_item_count(); j++) {
+                (*data)[i]->add_item(*src[i], j);
+                bytes += src[i]->get_item(j).size();
+            }
+        }
+
+        unique_lock<mutex> lock(_mutex);
+        for (auto& b : _queue) {
+            if (b.block_num == block_num) {
+                return;
+            }
+        }
+        // a block larger than the whole budget still goes through on its own
+        _changed.wait(lock, [&] { return _queue.empty() || _queuedBytes + bytes <= _maxBytes; });
+        _queue.push_back({block_num, filename, data, bytes});
+        _queuedBytes += bytes;
+        _changed.notify_all();
+    }
+
+    bool load(buffer_in_array& dest, uint block_num)
+    {
+        lock_guard<mutex> lock(_mutex);
+        for (auto& b : _queue) {
+            if (b.block_num == block_num) {
+                for (size_t i = 0; i < dest.size(); i++) {
+                    for (int j = 0; j < (*b.data)[i]->get_item_count(); j++) {
+                        dest[i]->add_item(*(*b.data)[i], j);
+                    }
+                }
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool loadRecord(buffer_in_array& dest, uint block_num, int index)
+    {
+        lock_guard<mutex> lock(_mutex);
+        for (auto& b : _queue) {
+            if (b.block_num == block_num) {
+                for (size_t i = 0; i < dest.size(); i++) {
+                    affirm(index < (*b.data)[i]->get_item_count(), "record outside its block");
+                    dest[i]->add_item(*(*b.data)[i], index);
+                }
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    class pending_block {
+    public:
+        uint                             block_num;
+        string                           filename;
+        shared_ptr<buffer_in_array>      data;
+        size_t                           bytes;
+    };
+
+    void run()
+    {
+        unique_lock<mutex> lock(_mutex);
+        for (;;) {
+            _changed.wait(lock, [&] { return _stop || !_queue.empty(); });
+            if (_queue.empty()) {
+                break;
+            }
+            // leave the block queued until it is on disk so loads of it
+            // can still be served from memory
+            pending_block& b = _queue.front();
+            lock.unlock();
+            try {
+                writeCacheFile(*b.data, b.filename, _index.get());
+            } catch (std::exception& e) {
+                // failure to write block to cache doesn't stop execution, only print an error
+                cerr << "ERROR writing block to cache: " << e.what() << endl;
+            }
+            lock.lock();
+            _queuedBytes -= b.bytes;
+            _queue.pop_front();
+            _changed.notify_all();
+        }
+    }
+
+    const size_t                        _maxBytes;
+    shared_ptr<cache_index>             _index;
+    size_t                              _queuedBytes;
+    bool                                _stop;
+    deque<pending_block>                _queue;
+    mutex                               _mutex;
+    condition_variable                  _changed;
+    thread                              _writer;
+};
+
+/* reader_cache
+ *
+ * The block files loadRecord read from last, kept mapped.  Mapping a file
+ * and reading its index costs far more than reading one record of it.
+ */
+
+class block_loader_cpio_cache::reader_cache {
+public:
+    reader_cache(const shared_ptr<cache_index>& index) :
+        _index(index)
+    {
+    }
+
+    // the mapped block file, or nullptr if the block isn't cached
+    shared_ptr<cpio::mapped_reader> open(uint block_num, const string& filename)
+    {
+        lock_guard<mutex> lock(_mutex);
+        for (auto it = _readers.begin(); it != _readers.end(); ++it) {
+            if (it->first == block_num) {
+                _readers.splice(_readers.end(), _readers, it);
+                return it->second;
+            }
+        }
+
+        auto reader = make_shared<cpio::mapped_reader>();
+        if (!reader->open(filename)) {
+            return nullptr;
+        }
+        if (_index) {
+            _index->touch(filename);
+        }
+        _readers.push_back({block_num, reader});
+        if (_readers.size() > maxReaders) {
+            _readers.pop_front();
+        }
+        return reader;
+    }
+
+private:
+    static const size_t maxReaders = 8;
+
+    shared_ptr<cache_index>                                 _index;
+    list<pair<uint, shared_ptr<cpio::mapped_reader>>>       _readers;
+    mutex                                                   _mutex;
+};
+
 block_loader_cpio_cache::block_loader_cpio_cache(const string& rootCacheDir,
                                                  const string& cache_id,
                                                  const string& version,
-                                                 shared_ptr<block_loader> loader)
-: block_loader(loader->blockSize()), _loader(loader)
+                                                 shared_ptr<block_loader> loader,
+                                                 size_t writeQueueBytes,
+                                                 size_t maxBytes)
+: block_loader(loader->blockSize(), loader->shardCount(), loader->shardIndex(),
+               loader->equalShards()),
+  _loader(loader)
 {
     invalidateOldCache(rootCacheDir, cache_id, version);
 
     _cacheDir = rootCacheDir + "/" + cache_id + "_" + version;
 
     makeDirectory(_cacheDir);
+
+    if (maxBytes > 0) {
+        _index = make_shared<cache_index>(rootCacheDir, maxBytes);
+    }
+    if (writeQueueBytes > 0) {
+        _writeQueue = make_shared<write_queue>(writeQueueBytes, _index);
+    }
+    _readers = make_shared<reader_cache>(_index);
 }
 
 void block_loader_cpio_cache::loadBlock(buffer_in_array& dest, uint block_num)
@@ -58,16 +518,60 @@ void block_loader_cpio_cache::loadBlock(buffer_in_array& dest, uint block_num)
     }
 }
 
+void block_loader_cpio_cache::loadRecord(buffer_in_array& dest, uint64_t record)
+{
+    uint block_num = record / _block_size;
+    int index = record % _block_size;
+    if (_writeQueue && _writeQueue->loadRecord(dest, block_num, index)) {
+        return;
+    }
+
+    shared_ptr<cpio::mapped_reader> reader = _readers->open(block_num, blockFilename(block_num));
+    if (reader) {
+        affirm(index < reader->itemCount(), "record outside its block");
+        for (uint i = 0; i < dest.size(); ++i) {
+            try {
+                reader->read(*dest[i], index, i);
+            } catch (std::exception& e) {
+                dest[i]->add_exception(std::current_exception());
+            }
+        }
+        return;
+    }
+
+    // load the whole block so it is written to the cache, and keep the
+    // one record of it that was asked for
+    buffer_in_array block(dest.size());
+    loadBlock(block, block_num);
+    for (uint i = 0; i < dest.size(); ++i) {
+        affirm(index < block[i]->get_item_count(), "record outside its block");
+        try {
+            dest[i]->add_item(*block[i], index);
+        } catch (std::exception& e) {
+            dest[i]->add_exception(std::current_exception());
+        }
+    }
+}
+
 bool block_loader_cpio_cache::loadBlockFromCache(buffer_in_array& dest, uint block_num)
 {
     // load a block from cpio cache into dest.  If file doesn't exist, return false.
-    //  If loading from cpio cache was successful return true.
-    cpio::file_reader reader;
+    //  If loading from cpio cache was successful return true.  Items are
+    //  views into the mapped file rather than copies.
+    if (_writeQueue && _writeQueue->load(dest, block_num)) {
+        return true;
+    }
+
+    cpio::mapped_reader reader;
 
-    if(!reader.open(blockFilename(block_num))) {
+    string filename = blockFilename(block_num);
+    if(!reader.open(filename)) {
         // couldn't load the file
         return false;
     }
+    if (_index) {
+        _index->touch(filename);
+    }
     // load cpio file into dest one item at a time
     for(int i=0; i < reader.itemCount(); ++i) {
         for (auto d : dest) {
@@ -87,11 +591,24 @@ bool block_loader_cpio_cache::loadBlockFromCache(buffer_in_array& dest, uint blo
 }
 
 void block_loader_cpio_cache::writeBlockToCache(buffer_in_array& buff, uint block_num)
+{
+    if (_writeQueue) {
+        _writeQueue->push(buff, block_num, blockFilename(block_num));
+    } else {
+        writeCacheFile(buff, blockFilename(block_num), _index.get());
+    }
+}
+
+void block_loader_cpio_cache::writeCacheFile(buffer_in_array& buff, const string& filename,
+                                             cache_index* index)
 {
     cpio::file_writer writer;
-    writer.open(blockFilename(block_num));
+    writer.open(filename);
     writer.write_all_records(buff);
     writer.close();
+    if (index) {
+        index->add(filename);
+    }
 }
 
 void block_loader_cpio_cache::invalidateOldCache(const string& rootCacheDir,
@@ -16,6 +16,7 @@
 #pragma once
 
 #include <string>
+#include <memory>
 
 #include "block_loader_file.hpp"
 
@@ -28,6 +29,25 @@
  * is used to help invalidate old versions of the same dataset.  If a cache is
  * created with the same cache_id as an existing cache, but a different version,
  * old version is deleted.
+ *
+ * With a non-zero writeQueueBytes, blocks that miss the cache are handed to
+ * the caller right away and written to the cache by a background thread.
+ * Blocks waiting to be written share their items with the block that was
+ * returned, and loading them again is served from the queue.  At most
+ * writeQueueBytes of blocks wait to be written; loadBlock blocks when the
+ * disk falls further behind than that.
+ *
+ * With a non-zero maxBytes, the least recently used block files are removed
+ * whenever the cache directories under rootCacheDir together hold more than
+ * maxBytes of them.  The order blocks were used in is kept in an index file
+ * in rootCacheDir that every cache sharing the root merges into under a
+ * file lock.
+ *
+ * loadRecord maps just the one record it needs.  The first record asked
+ * for from a block that isn't cached loads the whole block through
+ * loadBlock, so records drawn at random fill in the cache the same way
+ * blocks read in turn do.  The last few block files records were read
+ * from are kept mapped.
  */
 
 namespace nervana {
@@ -38,14 +58,23 @@ class nervana::block_loader_cpio_cache : public block_loader {
 public:
     block_loader_cpio_cache(const std::string& rootCacheDir,
                             const std::string& cache_id, const std::string& version,
-                            std::shared_ptr<block_loader> loader);
+                            std::shared_ptr<block_loader> loader,
+                            size_t writeQueueBytes = 0,
+                            size_t maxBytes = 0);
 
     void loadBlock(nervana::buffer_in_array& dest, uint block_num);
+    void loadRecord(nervana::buffer_in_array& dest, uint64_t record);
     uint objectCount();
 
 private:
+    class write_queue;
+    class cache_index;
+    class reader_cache;
+
     bool loadBlockFromCache(nervana::buffer_in_array& dest, uint block_num);
     void writeBlockToCache(nervana::buffer_in_array& dest, uint block_num);
+    static void writeCacheFile(nervana::buffer_in_array& buff, const std::string& filename,
+                               cache_index* index);
     std::string blockFilename(uint block_num);
 
     void invalidateOldCache(const std::string& rootCacheDir, const std::string& cache_id, const std::string& version);
@@ -56,4 +85,7 @@ private:
 
     std::string _cacheDir;
     std::shared_ptr<block_loader> _loader;
+    std::shared_ptr<cache_index> _index;
+    std::shared_ptr<write_queue> _writeQueue;
+    std::shared_ptr<reader_cache> _readers;
 };
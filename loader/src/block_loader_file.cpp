@@ -26,8 +26,11 @@ using namespace nervana;
 
 block_loader_file::block_loader_file(shared_ptr<nervana::manifest_csv> mfst,
                                      float subset_fraction,
-                                     uint block_size)
-: block_loader(block_size),
+                                     uint block_size,
+                                     uint shard_count,
+                                     uint shard_index,
+                                     bool equal_shards)
+: block_loader(block_size, shard_count, shard_index, equal_shards),
   _manifest(mfst),
   _subset_fraction(subset_fraction)
 {
@@ -42,6 +45,8 @@ void block_loader_file::loadBlock(nervana::buffer_in_array& dest, uint block_num
     // NOTE: end_i - begin_i may not be a full block for the last
     // block_num
 
+    affirm(inShard(block_num), "block_loader_file block is in another shard");
+
     // begin_i and end_i contain the indexes into the manifest file which
     // hold the requested block
     size_t begin_i = block_num * _block_size;
@@ -72,19 +77,31 @@ void block_loader_file::loadBlock(nervana::buffer_in_array& dest, uint block_num
     auto end_it = _manifest->begin() + end_i;
 
     for(auto it = begin_it; it != end_it; ++it) {
-        // load both object and target files into respective buffers
-        //
         // NOTE: if at some point in the future, loadFile is loading
         // files from a network like s3 it may make sense to use multiple
         // threads to make loads faster.  multiple threads would only
         // slow down reads from a magnetic disk.
-        auto file_list = *it;
-        for (uint i = 0; i < file_list.size(); i++) {
-            try {
-                loadFile(dest[i], file_list[i]);
-            } catch (std::exception& e) {
-                dest[i]->add_exception(std::current_exception());
-            }
+        loadFiles(dest, *it);
+    }
+}
+
+void block_loader_file::loadRecord(nervana::buffer_in_array& dest, uint64_t record)
+{
+    // a record's files can be read without the rest of its block
+    affirm(record < _manifest->objectCount(), "block_loader_file record outside manifest bounds");
+    affirm(inShard(record / _block_size), "block_loader_file record is in another shard");
+    loadFiles(dest, *(_manifest->begin() + record));
+}
+
+void block_loader_file::loadFiles(nervana::buffer_in_array& dest,
+                                  const nervana::manifest_csv::FilenameList& file_list)
+{
+    // load both object and target files into respective buffers
+    for (uint i = 0; i < file_list.size(); i++) {
+        try {
+            loadFile(dest[i], file_list[i]);
+        } catch (std::exception& e) {
+            dest[i]->add_exception(std::current_exception());
         }
     }
 }
@@ -21,7 +21,8 @@
 
 /* block_loader_file
  *
- * Loads blocks of files from a Manifest into a BufferPair.
+ * Loads blocks of files from a Manifest into a BufferPair.  With
+ * shard_count > 1 only the blocks of shard shard_index are read.
  *
  */
 
@@ -33,13 +34,18 @@ class nervana::block_loader_file : public block_loader {
 public:
     block_loader_file(std::shared_ptr<nervana::manifest_csv> manifest,
                       float subset_fraction,
-                      uint block_size);
+                      uint block_size,
+                      uint shard_count = 1,
+                      uint shard_index = 0,
+                      bool equal_shards = false);
 
     void loadBlock(nervana::buffer_in_array& dest, uint block_num);
+    void loadRecord(nervana::buffer_in_array& dest, uint64_t record);
     void loadFile(nervana::buffer_in* buff, const std::string& filename);
     uint objectCount();
 
 private:
+    void loadFiles(nervana::buffer_in_array& dest, const nervana::manifest_csv::FilenameList& file_list);
     off_t getFileSize(const std::string& filename);
 
     const std::shared_ptr<nervana::manifest_csv> _manifest;
@@ -70,38 +70,39 @@ void block_loader_nds::loadBlock(nervana::buffer_in_array& dest, uint block_num)
 
 void block_loader_nds::get(const string& url, stringstream &stream)
 {
-    // reuse curl connection across requests
-    _curl = curl_easy_init();
+    // each request gets its own handle so that blocks can be fetched from
+    // several reader threads at once
+    CURL* curl = curl_easy_init();
 
     // given a url, make an HTTP GET request and fill stream with
     // the body of the response
 
-    curl_easy_setopt(_curl, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(_curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
     // Prevent "longjmp causes uninitialized stack frame" bug
-    curl_easy_setopt(_curl, CURLOPT_NOSIGNAL, 1);
-    curl_easy_setopt(_curl, CURLOPT_ACCEPT_ENCODING, "deflate");
-    curl_easy_setopt(_curl, CURLOPT_WRITEFUNCTION, write_data);
-    curl_easy_setopt(_curl, CURLOPT_WRITEDATA, &stream);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1);
+    curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "deflate");
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_data);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &stream);
 
     // Perform the request, res will get the return code
-    CURLcode res = curl_easy_perform(_curl);
+    CURLcode res = curl_easy_perform(curl);
 
     // Check for errors
     if (res != CURLE_OK) {
         long http_code = 0;
-        curl_easy_getinfo (_curl, CURLINFO_RESPONSE_CODE, &http_code);
+        curl_easy_getinfo (curl, CURLINFO_RESPONSE_CODE, &http_code);
 
         stringstream ss;
         ss << "HTTP GET on " << url << "failed. ";
         ss << "status code: " << http_code << ". ";
         ss << curl_easy_strerror(res);
 
-        curl_easy_cleanup(_curl);
+        curl_easy_cleanup(curl);
         throw std::runtime_error(ss.str());
     }
 
-    curl_easy_cleanup(_curl);
+    curl_easy_cleanup(curl);
 }
 
 const string block_loader_nds::loadBlockURL(uint block_num)
@@ -51,7 +51,4 @@ private:
     const int _shard_index;
     unsigned int _objectCount;
     unsigned int _blockCount;
-
-    // reuse connection across requests
-    void* _curl;
 };
@@ -26,8 +26,21 @@
 using namespace std;
 using namespace nervana;
 
+namespace {
+    // records larger than this get a chunk of their own
+    const size_t default_chunk_size = 4 * 1024 * 1024;
+    const size_t item_alignment = 16;
+}
+
 void buffer_in::reset() {
     buffers.clear();
+
+    // chunks are reused unless some other buffer_in still shares part of one
+    chunks.erase(remove_if(chunks.begin(), chunks.end(),
+                           [](const chunk& c) { return c.data.use_count() > 1; }),
+                 chunks.end());
+    chunk_index = 0;
+    chunk_used = 0;
 }
 
 void buffer_in::shuffle(uint seed) {
@@ -35,39 +48,90 @@ void buffer_in::shuffle(uint seed) {
     std::shuffle(buffers.begin(), buffers.end(), rand_items);
 }
 
-vector<char>& buffer_in::get_item(int index) {
+span buffer_in::get_item(int index) {
     if (index >= (int) buffers.size()) {
         throw invalid_argument("index out-of-range");
     }
 
-    auto it = exceptions.find(index);
-    if (it != exceptions.end()) {
-        std::rethrow_exception(it->second);
+    const element& e = buffers[index];
+    if (e.error) {
+        std::rethrow_exception(e.error);
     }
 
-    return buffers[index];
+    return span(e.data.get(), e.size);
 }
 
 void buffer_in::add_item(const std::vector<char>& buf) {
-    buffers.push_back(buf);
+    shared_ptr<char> data = allocate(buf.size());
+    memcpy(data.get(), buf.data(), buf.size());
+    buffers.push_back({data, buf.size(), nullptr, -1});
+}
+
+void buffer_in::add_item(const char* data, size_t size, const shared_ptr<const void>& owner) {
+    // the element points at data but shares ownership of owner
+    buffers.push_back({shared_ptr<const char>(owner, data), size, nullptr, -1});
+}
+
+void buffer_in::add_item(buffer_in& src, int index) {
+    // get_item rethrows if src holds an exception at index
+    src.get_item(index);
+    buffers.push_back(src.buffers[index]);
 }
 
 void buffer_in::add_exception(std::exception_ptr e) {
-    // add an axception to exceptions
-    exceptions[buffers.size()] = e;
+    // an empty element holding the exception keeps indicies lined up
+    buffers.push_back({nullptr, 0, e, -1});
+}
 
-    // also add an empty vector to buffers to that indicies line up
-    std::vector<char> empty;
-    buffers.push_back(empty);
+void buffer_in::append(buffer_in& src) {
+    if (buffers.empty()) {
+        buffers.swap(src.buffers);
+    } else {
+        buffers.reserve(buffers.size() + src.buffers.size());
+        for (auto& b : src.buffers) {
+            buffers.push_back(std::move(b));
+        }
+    }
+    src.reset();
 }
 
 int buffer_in::get_item_count() {
     return buffers.size();
 }
 
+int64_t buffer_in::get_record(int index) {
+    return buffers.at(index).record;
+}
+
+void buffer_in::set_record(int index, int64_t record) {
+    buffers.at(index).record = record;
+}
+
 void buffer_in::read(istream& is, int size) {
     // read `size` bytes out of `ifs` and push into buffer
-    vector<char> b(size);
-    is.read(b.data(), size);
-    buffers.push_back(b);
+    shared_ptr<char> data = allocate(size);
+    is.read(data.get(), size);
+    buffers.push_back({data, (size_t)size, nullptr, -1});
+}
+
+shared_ptr<char> buffer_in::allocate(size_t size) {
+    // carve size bytes out of the current chunk, moving on to the next
+    // (possibly reused) chunk when it doesn't fit
+    size_t aligned = (size + item_alignment - 1) & ~(item_alignment - 1);
+    while (chunk_index < chunks.size()) {
+        chunk& c = chunks[chunk_index];
+        if (chunk_used + size <= c.size) {
+            char* p = c.data.get() + chunk_used;
+            chunk_used += aligned;
+            return shared_ptr<char>(c.data, p);
+        }
+        chunk_index++;
+        chunk_used = 0;
+    }
+
+    size_t chunk_size = std::max(default_chunk_size, size);
+    chunks.push_back({shared_ptr<char>(new char[chunk_size], default_delete<char[]>()), chunk_size});
+    chunk_index = chunks.size() - 1;
+    chunk_used = aligned;
+    return shared_ptr<char>(chunks.back().data, chunks.back().data.get());
 }
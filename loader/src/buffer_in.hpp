@@ -22,30 +22,86 @@
 #include <cstring>
 #include <iostream>
 #include <map>
+#include <memory>
 
 namespace nervana {
+    class span;
     class buffer_in;
     class buffer_in_array;
 }
 
+// span is a non-owning view of one record element held by a buffer_in.  It
+// stays valid until the buffer_in it came from (and every buffer_in the
+// element was shared with) is reset.
+class nervana::span {
+public:
+    span() : _data(nullptr), _size(0) {}
+    span(const char* data, size_t size) : _data(data), _size(size) {}
+
+    const char* data() const { return _data; }
+    size_t size() const { return _size; }
+    const char* begin() const { return _data; }
+    const char* end() const { return _data + _size; }
+    const char& operator[](size_t i) const { return _data[i]; }
+
+private:
+    const char* _data;
+    size_t      _size;
+};
+
+// buffer_in holds one component of a list of records.  Bytes read into a
+// buffer_in are packed into large reusable chunks and each record is an entry
+// in a table pointing into them, so reading allocates per chunk rather than
+// per record, and shuffling or handing records to another buffer_in only
+// moves table entries.  Entries may also share memory owned by something
+// else, such as a memory mapped cache file, without copying it.
 class nervana::buffer_in {
 public:
-    buffer_in() {}
+    buffer_in() : chunk_index(0), chunk_used(0) {}
     virtual ~buffer_in() {}
 
     void read(std::istream& is, int size);
     void reset();
-    std::vector<char>& get_item(int index);
+    span get_item(int index);
     void add_item(const std::vector<char>&);
+    // add size bytes at data, which stay alive for as long as owner does
+    void add_item(const char* data, size_t size, const std::shared_ptr<const void>& owner);
+    // share element index of src without copying it
+    void add_item(buffer_in& src, int index);
     void add_exception(std::exception_ptr);
+    // move all of src's items (and exceptions) onto the end of this buffer
+    void append(buffer_in& src);
 
     void shuffle(uint seed);
 
     int get_item_count();
 
+    // the position of item index in the whole dataset, or -1 if unknown.
+    // It travels with the item through shuffles and hand-offs.
+    int64_t get_record(int index);
+    void set_record(int index, int64_t record);
+
 private:
-    std::vector<std::vector<char>> buffers;
-    std::map<int, std::exception_ptr> exceptions;
+    class element {
+    public:
+        std::shared_ptr<const char> data;
+        size_t                      size;
+        std::exception_ptr          error;
+        int64_t                     record;
+    };
+
+    class chunk {
+    public:
+        std::shared_ptr<char>       data;
+        size_t                      size;
+    };
+
+    std::shared_ptr<char> allocate(size_t size);
+
+    std::vector<element> buffers;
+    std::vector<chunk>   chunks;
+    size_t               chunk_index;
+    size_t               chunk_used;
 };
 
 // buffer_in_array holds a vector of buffer_in*.  Each buffer_in* holds one component
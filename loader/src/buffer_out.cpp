@@ -55,11 +55,15 @@ char* buffer_out::get_item(size_t index) {
     return &_data[offset];
 }
 
-size_t buffer_out::get_item_count() {
+const char* buffer_out::get_item(size_t index) const {
+    return const_cast<buffer_out*>(this)->get_item(index);
+}
+
+size_t buffer_out::get_item_count() const {
     return _size / _item_size;
 }
 
-size_t buffer_out::size() {
+size_t buffer_out::size() const {
     return _size;
 }
 
@@ -34,10 +34,12 @@ public:
     virtual ~buffer_out();
 
     char* get_item(size_t index);
+    const char* get_item(size_t index) const;
     char* data() { return _data; }
+    const char* data() const { return _data; }
 
-    size_t get_item_count();
-    size_t size();
+    size_t get_item_count() const;
+    size_t size() const;
 
 private:
     buffer_out() = delete;
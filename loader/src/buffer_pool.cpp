@@ -14,25 +14,34 @@
 */
 
 #include "buffer_pool.hpp"
+#include "util.hpp"
 
 using namespace nervana;
 
-buffer_pool::buffer_pool() {
-    _exceptions.push_back(nullptr);
-    _exceptions.push_back(nullptr);
+buffer_pool::buffer_pool(int count)
+: _count(count), _exceptions(count, nullptr) {
+    affirm(count >= 2, "buffer_pool count must be >= 2");
 }
 
 void buffer_pool::write_exception(std::exception_ptr exception_ptr) {
     _exceptions[_writePos] = exception_ptr;
 }
 
+void buffer_pool::write_exception(std::exception_ptr exception_ptr, int index) {
+    _exceptions[index] = exception_ptr;
+}
+
 void buffer_pool::clear_exception() {
     _exceptions[_writePos] = nullptr;
 }
 
 void buffer_pool::reraise_exception() {
-    if(auto e = _exceptions[_readPos]) {
-        clear_exception();
+    reraise_exception(_readPos);
+}
+
+void buffer_pool::reraise_exception(int index) {
+    if(auto e = _exceptions[index]) {
+        _exceptions[index] = nullptr;
         std::rethrow_exception(e);
     }
 }
@@ -16,23 +16,35 @@
 #pragma once
 
 #include <vector>
+#include <exception>
 
 namespace nervana {
     class buffer_pool;
 }
 
-/* Base class buffer_pool only deals in exception handling for now */
+/* Base class buffer_pool deals in exception handling and the ring of `count` buffers
+ *
+ * The pools are handed between threads without a lock.  Each position in
+ * the ring is only moved by one thread, and a buffer and its exception are
+ * only touched by the side that currently owns it, so the atomic counts in
+ * the derived classes are all the synchronization needed.
+ */
 
 class nervana::buffer_pool {
 protected:
-    buffer_pool();
+    buffer_pool(int count);
 public:
     void write_exception(std::exception_ptr exception_ptr);
+    void write_exception(std::exception_ptr exception_ptr, int index);
     void reraise_exception();
+    void reraise_exception(int index);
+    int count() const { return _count; }
+    int read_pos() const { return _readPos; }
 
 protected:
     void clear_exception();
 
+    const int                       _count;
     std::vector<std::exception_ptr> _exceptions;
     int                             _readPos = 0;
     int                             _writePos = 0;
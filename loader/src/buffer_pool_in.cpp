@@ -21,8 +21,6 @@
 #include <algorithm>
 #include <vector>
 #include <thread>
-#include <mutex>
-#include <condition_variable>
 #include <fstream>
 
 #include "buffer_pool_in.hpp"
@@ -31,8 +29,9 @@
 using namespace std;
 using namespace nervana;
 
-buffer_pool_in::buffer_pool_in(unsigned int nbuffers_in)
-: buffer_pool()
+buffer_pool_in::buffer_pool_in(unsigned int nbuffers_in, int count)
+: buffer_pool(count),
+  _depth(count)
 {
     for (int i = 0; i < _count; i++) {
         _bufs.push_back(make_shared<buffer_in_array>(nbuffers_in));
@@ -48,6 +47,7 @@ buffer_in_array& buffer_pool_in::get_for_write()
     for (auto &b : buf_ary) {
         b->reset();
     }
+    clear_exception();
     return buf_ary;
 }
 
@@ -57,17 +57,24 @@ buffer_in_array& buffer_pool_in::get_for_read()
     return *_bufs[_readPos];
 }
 
+buffer_in_array& buffer_pool_in::get(int index)
+{
+    reraise_exception(index);
+    return *_bufs[index];
+}
+
 void buffer_pool_in::advance_read_pos()
 {
-    _used--;
     advance(_readPos);
+    _used--;
 }
 
 void buffer_pool_in::advance_write_pos()
 {
-    _used++;
+    // the buffer is filled before it is counted, and so visible to the
+    // reader once it sees the count
     advance(_writePos);
-    clear_exception();
+    _used++;
 }
 
 bool buffer_pool_in::empty()
@@ -79,22 +86,29 @@ bool buffer_pool_in::empty()
 bool buffer_pool_in::full()
 {
     affirm(_used <= _count, "buffer_pool_in used > count");
-    return (_used == _count);
+    return (_used >= _depth);
+}
+
+void buffer_pool_in::set_depth(int depth)
+{
+    affirm(depth > 0 && depth <= _count, "buffer_pool_in depth out of range");
+    _depth = depth;
+    signal_not_full();
 }
 
-std::mutex& buffer_pool_in::get_mutex()
+void buffer_pool_in::wait_for_not_empty(const std::function<bool()>& abort)
 {
-    return _mutex;
+    _nonEmpty.wait([&]() { return empty() == false || (abort && abort()); });
 }
 
-void buffer_pool_in::wait_for_not_empty(std::unique_lock<std::mutex>& lock)
+void buffer_pool_in::wait_for_non_full(const std::function<bool()>& abort)
 {
-    _nonEmpty.wait(lock);
+    _nonFull.wait([&]() { return full() == false || (abort && abort()); });
 }
 
-void buffer_pool_in::wait_for_non_full(std::unique_lock<std::mutex>& lock)
+void buffer_pool_in::wait_until(const std::function<bool()>& ready)
 {
-    _nonFull.wait(lock);
+    _nonEmpty.wait(ready);
 }
 
 void buffer_pool_in::signal_not_empty()
@@ -16,12 +16,13 @@
 #pragma once
 
 #include <vector>
-#include <mutex>
-#include <condition_variable>
+#include <atomic>
+#include <functional>
 #include <cstring>
 
 #include "buffer_pool.hpp"
 #include "buffer_in.hpp"
+#include "event_count.hpp"
 
 namespace nervana {
     class buffer_pool_in;
@@ -29,18 +30,31 @@ namespace nervana {
 
 class nervana::buffer_pool_in : public nervana::buffer_pool {
 public:
-    buffer_pool_in(unsigned int nbuffers_in);
+    buffer_pool_in(unsigned int nbuffers_in, int count = 2);
     virtual ~buffer_pool_in();
     buffer_in_array& get_for_write();
     buffer_in_array& get_for_read();
+    buffer_in_array& get(int index);
 
     void advance_read_pos();
     void advance_write_pos();
     bool empty();
     bool full();
-    std::mutex& get_mutex();
-    void wait_for_not_empty(std::unique_lock<std::mutex>& lock);
-    void wait_for_non_full(std::unique_lock<std::mutex>& lock);
+    int used() const { return _used; }
+
+    // fill at most depth of the `count` buffers ahead of the reader.  Read
+    // buffers only grow once written, so unused ones cost nothing.
+    void set_depth(int depth);
+    int depth() const { return _depth; }
+
+    // block until the pool is not empty (not full), or until abort returns
+    // true after a signal
+    void wait_for_not_empty(const std::function<bool()>& abort = nullptr);
+    void wait_for_non_full(const std::function<bool()>& abort = nullptr);
+
+    // block until ready returns true, checking again at each
+    // signal_not_empty.  For readers that take several buffers at once.
+    void wait_until(const std::function<bool()>& ready);
     void signal_not_empty();
     void signal_not_full();
 
@@ -48,10 +62,9 @@ protected:
     void advance(int& index);
 
 protected:
-    static constexpr int        _count = 2;
-    int                         _used = 0;
+    std::atomic<int>            _used{0};
+    std::atomic<int>            _depth;
     std::vector<std::shared_ptr<buffer_in_array>> _bufs;
-    std::mutex                  _mutex;
-    std::condition_variable     _nonFull;
-    std::condition_variable     _nonEmpty;
+    event_count                 _nonFull;
+    event_count                 _nonEmpty;
 };
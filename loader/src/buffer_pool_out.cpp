@@ -21,8 +21,6 @@
 #include <algorithm>
 #include <vector>
 #include <thread>
-#include <mutex>
-#include <condition_variable>
 #include <fstream>
 
 #include "buffer_pool_out.hpp"
@@ -32,8 +30,8 @@ using namespace std;
 using namespace nervana;
 
 buffer_pool_out::buffer_pool_out(const std::vector<size_t>& writeSizes,
-                                 size_t batchSize, bool pinned)
-: buffer_pool()
+                                 size_t batchSize, bool pinned, int count)
+: buffer_pool(count)
 {
     for (int i = 0; i < _count; i++) {
         _bufs.push_back(make_shared<buffer_out_array>(writeSizes, batchSize, pinned));
@@ -56,17 +54,35 @@ buffer_out_array& buffer_pool_out::get_for_read()
     return *_bufs[_readPos];
 }
 
+buffer_out_array& buffer_pool_out::get(int index)
+{
+    return *_bufs[index];
+}
+
+int buffer_pool_out::reserve_for_write()
+{
+    affirm(full() == false, "buffer_pool_out reserve when full");
+    int index = _reservePos;
+    advance(_reservePos);
+    write_exception(nullptr, index);
+    _busy++;
+    return index;
+}
+
 void buffer_pool_out::advance_read_pos()
 {
-    _used--;
+    // the buffer stays busy until the reader is done with it
     advance(_readPos);
+    _used--;
+    _busy--;
 }
 
 void buffer_pool_out::advance_write_pos()
 {
-    _used++;
+    // publish the oldest reserved buffer
+    affirm(_busy > _used, "buffer_pool_out publish without reserve");
     advance(_writePos);
-    clear_exception();
+    _used++;
 }
 
 bool buffer_pool_out::empty()
@@ -77,23 +93,18 @@ bool buffer_pool_out::empty()
 
 bool buffer_pool_out::full()
 {
-    affirm(_used <= _count, "buffer_pool_out used > count");
-    return (_used == _count);
-}
-
-std::mutex& buffer_pool_out::get_mutex()
-{
-    return _mutex;
+    affirm(_busy <= _count, "buffer_pool_out used > count");
+    return (_busy == _count);
 }
 
-void buffer_pool_out::wait_for_not_empty(std::unique_lock<std::mutex>& lock)
+void buffer_pool_out::wait_for_not_empty(const std::function<bool()>& abort)
 {
-    _nonEmpty.wait(lock);
+    _nonEmpty.wait([&]() { return empty() == false || (abort && abort()); });
 }
 
-void buffer_pool_out::wait_for_non_full(std::unique_lock<std::mutex>& lock)
+void buffer_pool_out::wait_for_non_full(const std::function<bool()>& abort)
 {
-    _nonFull.wait(lock);
+    _nonFull.wait([&]() { return full() == false || (abort && abort()); });
 }
 
 void buffer_pool_out::signal_not_empty()
@@ -16,32 +16,46 @@
 #pragma once
 
 #include <vector>
-#include <mutex>
-#include <condition_variable>
+#include <atomic>
+#include <functional>
 #include <cstring>
 
 #include "buffer_pool.hpp"
 #include "buffer_out.hpp"
+#include "event_count.hpp"
 
 namespace nervana {
     class buffer_pool_out;
 }
 
-// buffer_pool_out acts as our double buffer to hold data before copying to device
+// buffer_pool_out is a ring of `count` buffers (double buffering by default) to hold data
+// before copying to device
+//
+// Writers reserve a buffer before filling it and publish it with
+// advance_write_pos() once it is complete, so a minibatch can be decoded into
+// one buffer while the previous one is still being finished.  Buffers are
+// published in the order they were reserved.  Reserving, publishing and
+// reading may each happen on a different thread.
 class nervana::buffer_pool_out : public nervana::buffer_pool {
 public:
-    buffer_pool_out(const std::vector<size_t>& writeSizes, size_t batchSize, bool pinned = false);
+    buffer_pool_out(const std::vector<size_t>& writeSizes, size_t batchSize,
+                    bool pinned = false, int count = 2);
     virtual ~buffer_pool_out();
     buffer_out_array& get_for_write();
     buffer_out_array& get_for_read();
+    buffer_out_array& get(int index);
 
+    int reserve_for_write();
     void advance_read_pos();
     void advance_write_pos();
     bool empty();
     bool full();
-    std::mutex& get_mutex();
-    void wait_for_not_empty(std::unique_lock<std::mutex>& lock);
-    void wait_for_non_full(std::unique_lock<std::mutex>& lock);
+    int used() const { return _used; }
+
+    // block until the pool is not empty (not full), or until abort returns
+    // true after a signal
+    void wait_for_not_empty(const std::function<bool()>& abort = nullptr);
+    void wait_for_non_full(const std::function<bool()>& abort = nullptr);
     void signal_not_empty();
     void signal_not_full();
 
@@ -49,10 +63,11 @@ protected:
     void advance(int& index);
 
 protected:
-    static constexpr int        _count = 2;
-    int                         _used = 0;
+    // _used counts published buffers, _busy those reserved or published
+    std::atomic<int>            _used{0};
+    std::atomic<int>            _busy{0};
+    int                         _reservePos = 0;
     std::vector<std::shared_ptr<buffer_out_array>> _bufs;
-    std::mutex                  _mutex;
-    std::condition_variable     _nonFull;
-    std::condition_variable     _nonEmpty;
+    event_count                 _nonFull;
+    event_count                 _nonEmpty;
 };
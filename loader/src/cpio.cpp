@@ -13,6 +13,13 @@
  limitations under the License.
 */
 
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <thread>
+
 #include "cpio.hpp"
 #include "util.hpp"
 
@@ -50,6 +57,28 @@ namespace nervana
             write_single_value(ofs, &byte);
         }
     }
+
+    uint32_t update_checksum(uint32_t crc, const char* data, size_t size)
+    {
+        // CRC-32 (IEEE 802.3), as used by zlib
+        static const vector<uint32_t> table = [] {
+            vector<uint32_t> t(256);
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; k++) {
+                    c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+                }
+                t[i] = c;
+            }
+            return t;
+        }();
+
+        crc = ~crc;
+        for (size_t i = 0; i < size; i++) {
+            crc = table[(crc ^ (uint8_t) data[i]) & 0xFF] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
 }
 
 cpio::record_header::record_header() :
@@ -125,7 +154,7 @@ void cpio::record_header::write(ostream& ofs, uint fileSize, const char* fileNam
 
 cpio::header::header()
 : _formatVersion(FORMAT_VERSION), _writerVersion(WRITER_VERSION),
-  _itemCount(0)
+  _itemCount(0), _elementCount(0)
 {
     memset(_dataType, 0, sizeof(_dataType));
     memset(_unused, 0, sizeof(_unused));
@@ -141,6 +170,7 @@ void cpio::header::read(istream& ifs)
     read_single_value(ifs, &_writerVersion);
     read_single_value(ifs, &_dataType);
     read_single_value(ifs, &_itemCount);
+    read_single_value(ifs, &_elementCount);
     read_single_value(ifs, &_unused);
 }
 
@@ -151,24 +181,36 @@ void cpio::header::write(ostream& ofs)
     write_single_value(ofs, &_writerVersion);
     write_single_value(ofs, &_dataType);
     write_single_value(ofs, &_itemCount);
+    write_single_value(ofs, &_elementCount);
     write_single_value(ofs, &_unused);
 }
 
 cpio::trailer::trailer()
+: _indexOffset(0), _checksum(0), _unused(0)
 {
-    memset(_unused, 0, sizeof(_unused));
 }
 
 void cpio::trailer::write(ostream& ofs)
 {
+    write_single_value(ofs, &_indexOffset);
+    write_single_value(ofs, &_checksum);
     write_single_value(ofs, &_unused);
 }
 
 void cpio::trailer::read(istream& ifs)
 {
+    read_single_value(ifs, &_indexOffset);
+    read_single_value(ifs, &_checksum);
     read_single_value(ifs, &_unused);
 }
 
+size_t cpio::trailer::offsetFromEnd()
+{
+    // the trailer's data is followed only by the cpio footer entry
+    size_t nameSize = strlen(CPIO_FOOTER) + 1;
+    return sizeof(trailer) + sizeof(record_header) + nameSize + nameSize % 2;
+}
+
 
 
 
@@ -195,6 +237,29 @@ void cpio::reader::readHeader() {
     }
 
     _header.read(*_is);
+    readIndex();
+}
+
+void cpio::reader::readIndex() {
+    _index.clear();
+    if (!indexed()) {
+        return;
+    }
+
+    auto start = _is->tellg();
+    _is->seekg(0, _is->end);
+    size_t size = _is->tellg();
+    affirm(size >= trailer::offsetFromEnd(), "cpio file truncated");
+    _is->seekg(size - trailer::offsetFromEnd(), _is->beg);
+    _trailer.read(*_is);
+
+    _index.resize((size_t) _header._itemCount * _header._elementCount);
+    _is->seekg(_trailer._indexOffset, _is->beg);
+    _is->read((char*) _index.data(), _index.size() * sizeof(index_entry));
+    if (!*_is) {
+        throw std::runtime_error("could not read cpio index");
+    }
+    _is->seekg(start);
 }
 
 void cpio::reader::read(nervana::buffer_in& dest) {
@@ -204,10 +269,50 @@ void cpio::reader::read(nervana::buffer_in& dest) {
     readPadding(*_is, datumSize);
 }
 
+void cpio::reader::read(nervana::buffer_in& dest, int record_idx, int element_idx) {
+    affirm(indexed(), "cpio file has no index");
+    affirm(record_idx >= 0 && record_idx < itemCount(), "record index out of range");
+    affirm(element_idx >= 0 && element_idx < elementCount(), "element index out of range");
+    const index_entry& entry = _index[record_idx * elementCount() + element_idx];
+    _is->seekg(entry._offset, _is->beg);
+    dest.read(*_is, entry._size);
+}
+
+bool cpio::reader::indexed() {
+    return _header._formatVersion >= 2;
+}
+
+bool cpio::reader::validate() {
+    if (!indexed()) {
+        return true;
+    }
+
+    auto start = _is->tellg();
+    uint32_t checksum = 0;
+    vector<char> data;
+    for (const index_entry& entry : _index) {
+        data.resize(entry._size);
+        _is->seekg(entry._offset, _is->beg);
+        _is->read(data.data(), entry._size);
+        if (!*_is) {
+            _is->clear();
+            _is->seekg(start);
+            return false;
+        }
+        checksum = update_checksum(checksum, data.data(), data.size());
+    }
+    _is->seekg(start);
+    return checksum == _trailer._checksum;
+}
+
 int cpio::reader::itemCount() {
     return _header._itemCount;
 }
 
+int cpio::reader::elementCount() {
+    return _header._elementCount;
+}
+
 cpio::file_reader::file_reader() {
 }
 
@@ -234,6 +339,134 @@ void cpio::file_reader::close() {
     }
 }
 
+cpio::mapped_reader::mapped_reader() :
+    _mapSize(0),
+    _next(0)
+{
+}
+
+cpio::mapped_reader::~mapped_reader() {
+    close();
+}
+
+bool cpio::mapped_reader::open(const string& fileName) {
+    // returns true if file was mapped successfully.
+    close();
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+    size_t size = st.st_size;
+    void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        return false;
+    }
+    _map = shared_ptr<const char>((const char*) addr, [size](const char* p) {
+        munmap((void*) p, size);
+    });
+    _mapSize = size;
+
+    // the stream is only used to parse headers, the mapping is never written
+    memory_stream ms(const_cast<char*>(_map.get()), _mapSize);
+    record_header rh;
+    uint fileSize;
+    rh.read(ms, &fileSize);
+    if(fileSize != sizeof(_header)) {
+        stringstream ss;
+        ss << "unexpected header size.  expected " << sizeof(_header);
+        ss << " found " << fileSize;
+        throw std::runtime_error(ss.str());
+    }
+    _header.read(ms);
+
+    if (_header._formatVersion >= 2) {
+        indexEntries(fileName);
+        return true;
+    }
+
+    // version 1 files have no index, so walk the entries up to the trailer
+    for (;;) {
+        affirm((size_t) ms.tellg() + sizeof(record_header) <= _mapSize, "cpio file truncated " + fileName);
+        rh.read(ms, &fileSize);
+        size_t offset = ms.tellg();
+        const char* name = _map.get() + offset - rh._namesize - rh._namesize % 2;
+        if (strcmp(name, "cpiotlr") == 0) {
+            break;
+        }
+        affirm(offset + fileSize <= _mapSize, "cpio file truncated " + fileName);
+        _entries.push_back(span(_map.get() + offset, fileSize));
+        ms.seekg(fileSize + fileSize % 2, ms.cur);
+    }
+
+    return true;
+}
+
+void cpio::mapped_reader::indexEntries(const string& fileName) {
+    affirm(_mapSize >= trailer::offsetFromEnd(), "cpio file truncated " + fileName);
+    memory_stream ms(const_cast<char*>(_map.get()), _mapSize);
+    ms.seekg(_mapSize - trailer::offsetFromEnd(), ms.beg);
+    _trailer.read(ms);
+
+    size_t count = (size_t) _header._itemCount * _header._elementCount;
+    affirm(_trailer._indexOffset + count * sizeof(index_entry) <= _mapSize,
+           "cpio file truncated " + fileName);
+    const index_entry* index = (const index_entry*) (_map.get() + _trailer._indexOffset);
+    _entries.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        affirm(index[i]._offset + index[i]._size <= _mapSize, "cpio file truncated " + fileName);
+        _entries.push_back(span(_map.get() + index[i]._offset, index[i]._size));
+    }
+}
+
+void cpio::mapped_reader::close() {
+    _map.reset();
+    _mapSize = 0;
+    _entries.clear();
+    _next = 0;
+}
+
+void cpio::mapped_reader::read(nervana::buffer_in& dest) {
+    affirm(_next < _entries.size(), "read past the last cpio entry");
+    const span& entry = _entries[_next++];
+    dest.add_item(entry.data(), entry.size(), _map);
+}
+
+void cpio::mapped_reader::read(nervana::buffer_in& dest, int record_idx, int element_idx) {
+    // version 1 headers don't record the element count, but every entry
+    // was indexed when the file was opened
+    affirm(record_idx >= 0 && record_idx < itemCount(), "record index out of range");
+    int elements = _entries.size() / itemCount();
+    affirm(element_idx >= 0 && element_idx < elements, "element index out of range");
+    const span& entry = _entries[record_idx * elements + element_idx];
+    dest.add_item(entry.data(), entry.size(), _map);
+}
+
+bool cpio::mapped_reader::validate() {
+    if (_header._formatVersion < 2) {
+        return true;
+    }
+
+    uint32_t checksum = 0;
+    for (const span& entry : _entries) {
+        checksum = update_checksum(checksum, entry.data(), entry.size());
+    }
+    return checksum == _trailer._checksum;
+}
+
+int cpio::mapped_reader::itemCount() {
+    return _header._itemCount;
+}
+
+int cpio::mapped_reader::elementCount() {
+    return _header._elementCount;
+}
+
 cpio::file_writer::~file_writer()
 {
     close();
@@ -243,7 +476,13 @@ void cpio::file_writer::open(const std::string& fileName, const std::string& dat
 {
     static_assert(sizeof(_header) == 64, "file header is not 64 bytes");
     _fileName = fileName;
-    _tempName = fileName + ".tmp";
+    // reader threads may write the same block at the same time.  Each one
+    // writes its own temp file and the last rename wins.
+    stringstream temp_name;
+    temp_name << fileName << "." << this_thread::get_id() << ".tmp";
+    _tempName = temp_name.str();
+    _index.clear();
+    _trailer = trailer();
     _ofs.open(_tempName, ostream::binary);
     _recordHeader.write(_ofs, 64, "cpiohdr");
     _fileHeaderOffset = _ofs.tellp();
@@ -257,7 +496,15 @@ void cpio::file_writer::open(const std::string& fileName, const std::string& dat
 void cpio::file_writer::close()
 {
     if (_ofs.is_open() == true) {
-        // Write the trailer.
+        // Write the index, then the trailer pointing at it.
+        static_assert(sizeof(index_entry) == 16,
+                      "index entry is not 16 bytes");
+        uint indexSize = _index.size() * sizeof(index_entry);
+        _recordHeader.write(_ofs, indexSize, "cpioidx");
+        _trailer._indexOffset = _ofs.tellp();
+        _ofs.write((const char*) _index.data(), indexSize);
+        writePadding(_ofs, indexSize);
+
         static_assert(sizeof(_trailer) == 16,
                       "file trailer is not 16 bytes");
         _recordHeader.write(_ofs, 16, "cpiotlr");
@@ -291,7 +538,7 @@ void cpio::file_writer::write_record(nervana::buffer_in_array& buff, int record_
     uint element_idx = 0;
     for (auto b : buff)
     {
-        const vector<char>& record_element = b->get_item(record_idx);
+        span record_element = b->get_item(record_idx);
         write_record_element(record_element.data(), record_element.size(), element_idx++);
     }
     increment_record_count();
@@ -302,6 +549,9 @@ void cpio::file_writer::write_record_element(const char* elem, uint elem_size, u
     char fileName[16];
     snprintf(fileName, sizeof(fileName), "rec_%07d.%02d", _header._itemCount, element_idx);
     _recordHeader.write(_ofs, elem_size, fileName);
+    _index.push_back({(uint64_t) _ofs.tellp(), elem_size, 0});
+    _trailer._checksum = update_checksum(_trailer._checksum, elem, elem_size);
+    _header._elementCount = std::max(_header._elementCount, element_idx + 1);
     _ofs.write(elem, elem_size);
     writePadding(_ofs, elem_size);
 }
@@ -29,7 +29,7 @@
 
 #include "buffer_in.hpp"
 
-#define FORMAT_VERSION  1
+#define FORMAT_VERSION  2
 #define WRITER_VERSION  1
 #define MAGIC_STRING    "MACR"
 #define CPIO_FOOTER     "TRAILER!!!"
@@ -39,8 +39,10 @@ namespace nervana {
         class record_header;
         class header;
         class trailer;
+        class index_entry;
         class reader;
         class file_reader;
+        class mapped_reader;
         class file_writer;
     }
 }
@@ -59,10 +61,19 @@ Individual items are packed into a macrobatch file as follows:
     - datum 2
     - target 2
       ...
+    - index (format version 2)
     - trailer
 
 Each of these items comprises of a cpio header record followed by data.
 
+Version 2 files add an index holding the offset and size of every record
+element and store the index offset and a checksum of all record elements
+in the trailer.  The trailer is always the last thing before the cpio
+footer so it can be found by seeking back from the end of the file, which
+lets a reader go straight to any record or validate a block without walking
+every record header.  Version 1 files have neither and are still read
+sequentially.
+
 */
 
 class nervana::cpio::record_header {
@@ -92,6 +103,7 @@ public:
 
 class nervana::cpio::header {
 friend class reader;
+friend class mapped_reader;
 friend class file_writer;
 public:
     header();
@@ -105,18 +117,38 @@ private:
     uint32_t        _writerVersion;
     char            _dataType[8];
     uint32_t        _itemCount;
-    uint8_t         _unused[40];
+    uint32_t        _elementCount;
+    uint8_t         _unused[36];
 #pragma pack()
 };
 
 class nervana::cpio::trailer {
+friend class reader;
+friend class mapped_reader;
+friend class file_writer;
 public:
     trailer() ;
     void write(std::ostream& ofs);
     void read(std::istream& ifs);
 
+    // distance of the trailer's data from the end of the file
+    static size_t offsetFromEnd();
+
 private:
-    uint32_t        _unused[4];
+#pragma pack(1)
+    uint64_t        _indexOffset;
+    uint32_t        _checksum;
+    uint32_t        _unused;
+#pragma pack()
+};
+
+class nervana::cpio::index_entry {
+public:
+#pragma pack(1)
+    uint64_t        _offset;
+    uint32_t        _size;
+    uint32_t        _unused;
+#pragma pack()
 };
 
 class nervana::cpio::reader {
@@ -126,16 +158,30 @@ public:
 
     void read(nervana::buffer_in& dest);
 
+    // version 2 files only: read one element of record record_idx.  This
+    // moves the stream, so it shouldn't be mixed with sequential reads.
+    void read(nervana::buffer_in& dest, int record_idx, int element_idx);
+
+    // true if the file has an index, so records can be read in any order
+    bool indexed();
+
+    // recompute the checksum of a version 2 file.  Version 1 files have
+    // no checksum and always pass.
+    bool validate();
+
     int itemCount() ;
+    int elementCount();
 
 protected:
     void readHeader();
+    void readIndex();
 
     std::istream*   _is;
 
     header          _header;
     trailer         _trailer;
     record_header   _recordHeader;
+    std::vector<index_entry> _index;
 };
 
 /*
@@ -155,6 +201,40 @@ private:
     std::ifstream   _ifs;
 };
 
+/*
+ * mapped_reader maps a whole cpio file read-only and indexes its entries
+ * when it is opened.  read() hands each entry to a buffer_in as a view into
+ * the mapping instead of copying it, and the mapping stays alive until the
+ * last buffer_in holding one of its entries is reset.
+ */
+
+class nervana::cpio::mapped_reader {
+public:
+    mapped_reader();
+    ~mapped_reader();
+
+    bool open(const std::string& fileName);
+    void close();
+
+    void read(nervana::buffer_in& dest);
+    void read(nervana::buffer_in& dest, int record_idx, int element_idx);
+
+    bool validate();
+
+    int itemCount();
+    int elementCount();
+
+private:
+    void indexEntries(const std::string& fileName);
+
+    std::shared_ptr<const char> _map;
+    size_t                      _mapSize;
+    header                      _header;
+    trailer                     _trailer;
+    std::vector<span>           _entries;
+    size_t                      _next;
+};
+
 class nervana::cpio::file_writer {
 public:
     ~file_writer();
@@ -173,6 +253,7 @@ private:
     trailer         _trailer;
     record_header   _recordHeader;
     int             _fileHeaderOffset;
+    std::vector<index_entry> _index;
     std::string     _fileName;
     std::string     _tempName;
 };
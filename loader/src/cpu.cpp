@@ -0,0 +1,170 @@
+/*
+ Copyright 2016 Nervana Systems Inc.
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "cpu.hpp"
+#include "util.hpp"
+
+using namespace std;
+using namespace nervana;
+
+namespace {
+    int read_quota(const string& quota_file, const string& period_file)
+    {
+        // a negative quota means unlimited
+        ifstream q(quota_file);
+        ifstream p(period_file);
+        long quota, period;
+        if (q >> quota && p >> period && quota > 0 && period > 0) {
+            return ceil(double(quota) / period);
+        }
+        return 0;
+    }
+
+#ifdef __linux__
+    void pin_handle(pthread_t handle, const vector<int>& cpus)
+    {
+        if (cpus.empty()) {
+            return;
+        }
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int c : cpus) {
+            affirm(c >= 0 && c < CPU_SETSIZE, "cpu " + to_string(c) + " out of range");
+            CPU_SET(c, &set);
+        }
+        int rc = pthread_setaffinity_np(handle, sizeof(set), &set);
+        affirm(rc == 0, "unable to pin thread to cpus " + join(cpus, ","));
+    }
+#endif
+}
+
+vector<int> cpu::allowed()
+{
+    vector<int> rc;
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int c = 0; c < CPU_SETSIZE; c++) {
+            if (CPU_ISSET(c, &set)) {
+                rc.push_back(c);
+            }
+        }
+    }
+#endif
+    if (rc.empty()) {
+        int count = thread::hardware_concurrency();
+        for (int c = 0; c < count; c++) {
+            rc.push_back(c);
+        }
+    }
+    return rc;
+}
+
+int cpu::quota()
+{
+    // cgroup v2 holds "<quota> <period>" or "max <period>"
+    ifstream v2("/sys/fs/cgroup/cpu.max");
+    string quota;
+    long period;
+    if (v2 >> quota >> period) {
+        return quota == "max" || period <= 0 ? 0 : ceil(stod(quota) / period);
+    }
+    for (string dir : {"/sys/fs/cgroup/cpu/", "/sys/fs/cgroup/cpu,cpuacct/"}) {
+        int rc = read_quota(dir + "cpu.cfs_quota_us", dir + "cpu.cfs_period_us");
+        if (rc > 0) {
+            return rc;
+        }
+    }
+    return 0;
+}
+
+int cpu::available()
+{
+    int count = allowed().size();
+    int limit = quota();
+    if (limit > 0) {
+        count = min(count, limit);
+    }
+    return max(count, 1);
+}
+
+vector<int> cpu::parse_list(const string& list)
+{
+    vector<int> rc;
+    stringstream ss(list);
+    string range;
+    while (getline(ss, range, ',')) {
+        range.erase(remove_if(range.begin(), range.end(), ::isspace), range.end());
+        if (range.empty()) {
+            continue;
+        }
+        try {
+            size_t dash = range.find('-');
+            int first = stoi(range.substr(0, dash));
+            int last = dash == string::npos ? first : stoi(range.substr(dash + 1));
+            affirm(first >= 0 && first <= last, "");
+            for (int c = first; c <= last; c++) {
+                rc.push_back(c);
+            }
+        } catch (exception&) {
+            throw invalid_argument("invalid cpu list '" + list + "'");
+        }
+    }
+    return rc;
+}
+
+vector<int> cpu::node(int node)
+{
+    ifstream f("/sys/devices/system/node/node" + to_string(node) + "/cpulist");
+    string list;
+    getline(f, list);
+    affirm(!list.empty(), "no cpus found for NUMA node " + to_string(node));
+
+    vector<int> all = allowed();
+    vector<int> rc;
+    for (int c : parse_list(list)) {
+        if (find(all.begin(), all.end(), c) != all.end()) {
+            rc.push_back(c);
+        }
+    }
+    affirm(rc.size() > 0, "no allowed cpus on NUMA node " + to_string(node));
+    return rc;
+}
+
+void cpu::pin(thread& t, const vector<int>& cpus)
+{
+#ifdef __linux__
+    pin_handle(t.native_handle(), cpus);
+#endif
+}
+
+void cpu::pin(const vector<int>& cpus)
+{
+#ifdef __linux__
+    pin_handle(pthread_self(), cpus);
+#endif
+}
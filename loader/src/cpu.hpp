@@ -0,0 +1,50 @@
+/*
+ Copyright 2016 Nervana Systems Inc.
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#pragma once
+
+#include <string>
+#include <thread>
+#include <vector>
+
+/* cpu
+ *
+ * How many cpus the loader may really use and where its threads run.
+ * Inside a container hardware_concurrency() reports the whole host, while
+ * the affinity mask and the cgroup quota say what the process will get.
+ *
+ */
+namespace nervana {
+    namespace cpu {
+        // cpus in this process's affinity mask
+        std::vector<int> allowed();
+
+        // the cgroup cpu quota rounded up to whole cpus, 0 when unlimited
+        int quota();
+
+        // number of threads that can run at once, at least 1
+        int available();
+
+        // parses a list such as "0-3,8,10-11"
+        std::vector<int> parse_list(const std::string& list);
+
+        // the allowed cpus on NUMA node `node`
+        std::vector<int> node(int node);
+
+        // restrict a thread to cpus.  An empty list leaves it unchanged.
+        void pin(std::thread& thread, const std::vector<int>& cpus);
+        void pin(const std::vector<int>& cpus);
+    }
+}
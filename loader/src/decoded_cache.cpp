@@ -0,0 +1,211 @@
+/*
+ Copyright 2016 Nervana Systems Inc.
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <numeric>
+#include <sstream>
+
+#include "decoded_cache.hpp"
+#include "util.hpp"
+
+using namespace std;
+using namespace nervana;
+
+#define DECODED_MAGIC "AEONDEC1"
+
+namespace
+{
+    // the parameters of a distribution, or none if key isn't set
+    vector<float> params(const nlohmann::json& image, const string& key)
+    {
+        auto it = image.find(key);
+        return it == image.end() ? vector<float>() : it->get<vector<float>>();
+    }
+
+    bool spread(const nlohmann::json& image, const string& key)
+    {
+        vector<float> p = params(image, key);
+        return p.size() > 1 && p[0] != p[1];
+    }
+
+    bool randomized_image(const nlohmann::json& image)
+    {
+        if (!image.is_object()) {
+            return false;
+        }
+        // lighting is a normal distribution, its second parameter the spread
+        vector<float> lighting = params(image, "lighting");
+        return spread(image, "scale") ||
+               spread(image, "horizontal_distortion") ||
+               spread(image, "angle") ||
+               spread(image, "photometric") ||
+               (lighting.size() > 1 && lighting[1] != 0) ||
+               image.value("flip_enable", false) ||
+               !image.value("center", true);
+    }
+
+    bool randomized_audio(const nlohmann::json& audio)
+    {
+        if (!audio.is_object()) {
+            return false;
+        }
+        // noise is drawn from the noise files, at a random offset and level
+        return audio.value("add_noise_probability", 0.0f) > 0 ||
+               spread(audio, "time_scale_fraction");
+    }
+}
+
+decoded_cache::decoded_cache(const string& directory, const string& config_hash,
+                             size_t record_count, const vector<size_t>& item_sizes)
+: _filename(directory + "/" + config_hash + ".decoded"),
+  _item_sizes(item_sizes),
+  _record_count(record_count),
+  _record_size(accumulate(item_sizes.begin(), item_sizes.end(), (size_t) 0)),
+  _map(nullptr),
+  _states(nullptr)
+{
+    // a state byte per record after the header, then the records themselves
+    // starting on a page boundary
+    size_t page = sysconf(_SC_PAGESIZE);
+    _data_offset = (sizeof(header) + _record_count + page - 1) / page * page;
+    _file_size = _data_offset + _record_count * _record_size;
+
+    int fd = open(_filename.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd == -1) {
+        throw std::runtime_error("could not open decoded cache " + _filename + ": " + strerror(errno));
+    }
+
+    // the first process to get here sizes the file and writes the header.
+    // The file is sparse, so records take no space until they are stored.
+    flock(fd, LOCK_EX);
+    struct stat stats;
+    fstat(fd, &stats);
+    bool fresh = stats.st_size == 0;
+    if (fresh && ftruncate(fd, _file_size) != 0) {
+        flock(fd, LOCK_UN);
+        close(fd);
+        throw std::runtime_error("could not size decoded cache " + _filename + ": " + strerror(errno));
+    }
+    if (!fresh && (size_t) stats.st_size != _file_size) {
+        flock(fd, LOCK_UN);
+        close(fd);
+        throw std::runtime_error("decoded cache " + _filename + " doesn't match this configuration");
+    }
+
+    void* addr = mmap(nullptr, _file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        flock(fd, LOCK_UN);
+        close(fd);
+        throw std::runtime_error("could not map decoded cache " + _filename + ": " + strerror(errno));
+    }
+    _map = (char*) addr;
+    _states = (uint8_t*) (_map + sizeof(header));
+
+    header* h = (header*) _map;
+    if (fresh) {
+        memcpy(h->magic, DECODED_MAGIC, sizeof(h->magic));
+        h->record_count = _record_count;
+        h->record_size = _record_size;
+        h->item_count = _item_sizes.size();
+    }
+    flock(fd, LOCK_UN);
+    close(fd);
+
+    if (memcmp(h->magic, DECODED_MAGIC, sizeof(h->magic)) != 0 ||
+        h->record_count != _record_count ||
+        h->record_size != _record_size ||
+        h->item_count != _item_sizes.size()) {
+        munmap(_map, _file_size);
+        throw std::runtime_error("decoded cache " + _filename + " doesn't match this configuration");
+    }
+}
+
+decoded_cache::~decoded_cache()
+{
+    munmap(_map, _file_size);
+}
+
+bool decoded_cache::load(int64_t record, buffer_out_array& out, int index)
+{
+    if (record < 0 || (size_t) record >= _record_count ||
+        __atomic_load_n(&_states[record], __ATOMIC_ACQUIRE) != READY) {
+        return false;
+    }
+
+    const char* src = record_data(record);
+    for (size_t i = 0; i < _item_sizes.size(); ++i) {
+        memcpy(out[i]->get_item(index), src, _item_sizes[i]);
+        src += _item_sizes[i];
+    }
+    return true;
+}
+
+void decoded_cache::store(int64_t record, buffer_out_array& out, int index)
+{
+    if (record < 0 || (size_t) record >= _record_count) {
+        return;
+    }
+
+    // claim the slot so two processes never write the same record
+    uint8_t expected = EMPTY;
+    if (!__atomic_compare_exchange_n(&_states[record], &expected, (uint8_t) WRITING, false,
+                                     __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return;
+    }
+
+    char* dst = record_data(record);
+    for (size_t i = 0; i < _item_sizes.size(); ++i) {
+        memcpy(dst, out[i]->get_item(index), _item_sizes[i]);
+        dst += _item_sizes[i];
+    }
+    __atomic_store_n(&_states[record], (uint8_t) READY, __ATOMIC_RELEASE);
+}
+
+char* decoded_cache::record_data(int64_t record)
+{
+    return _map + _data_offset + record * _record_size;
+}
+
+bool decoded_cache::randomized(const nlohmann::json& config)
+{
+    // the positive and negative anchors of a localization target are
+    // sampled with a generator no setting fixes
+    if (config.value("type", "") == "image,localization") {
+        return true;
+    }
+
+    // video frames are transformed as images
+    auto image = config.find("image");
+    auto audio = config.find("audio");
+    auto video = config.find("video");
+    if (image != config.end() && randomized_image(*image)) {
+        return true;
+    }
+    if (audio != config.end() && randomized_audio(*audio)) {
+        return true;
+    }
+    if (video != config.end() && video->is_object()) {
+        auto frame = video->find("frame");
+        return frame != video->end() && randomized_image(*frame);
+    }
+    return false;
+}
@@ -0,0 +1,93 @@
+/*
+ Copyright 2016 Nervana Systems Inc.
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "buffer_out.hpp"
+#include "json.hpp"
+
+/* decoded_cache
+ *
+ * Keeps fully decoded and transformed records in a memory mapped file so
+ * that epochs after the first, and other processes running the same
+ * configuration, copy them instead of decoding them again.  Records are
+ * addressed by their position in the dataset and each one is a fixed size
+ * slot holding its item of every output buffer.  The file name carries a
+ * hash of everything that determines the records' contents.
+ *
+ * Only useful, and only correct, when the transforms involve no randomness.
+ * A record is written by whichever process decodes it first; the others
+ * skip storing it.  A slot left half written by a process that died is
+ * never used.
+ */
+
+namespace nervana {
+    class decoded_cache;
+}
+
+class nervana::decoded_cache {
+public:
+    decoded_cache(const std::string& directory, const std::string& config_hash,
+                  size_t record_count, const std::vector<size_t>& item_sizes);
+    ~decoded_cache();
+
+    // copy record into item index of out.  Returns false if it isn't cached.
+    bool load(int64_t record, nervana::buffer_out_array& out, int index);
+
+    // save item index of out as record, unless it is already saved
+    void store(int64_t record, nervana::buffer_out_array& out, int index);
+
+    // true if the loader configuration draws anything at random, which the
+    // cache would freeze at whatever was drawn first.  For images and video
+    // frames that is a range of scale, horizontal_distortion, angle or
+    // photometric, lighting with a spread, flip_enable, or a crop that isn't
+    // centered.  For audio it is a nonzero add_noise_probability or a range
+    // of time_scale_fraction.  Localization always samples its anchors at
+    // random.
+    static bool randomized(const nlohmann::json& config);
+
+private:
+    decoded_cache() = delete;
+    decoded_cache(const decoded_cache&) = delete;
+
+    class header {
+    public:
+        char        magic[8];
+        uint64_t    record_count;
+        uint64_t    record_size;
+        uint64_t    item_count;
+    };
+
+    enum state : uint8_t {
+        EMPTY   = 0,
+        WRITING = 1,
+        READY   = 2
+    };
+
+    char* record_data(int64_t record);
+
+    std::string         _filename;
+    std::vector<size_t> _item_sizes;
+    size_t              _record_count;
+    size_t              _record_size;
+    size_t              _data_offset;
+    size_t              _file_size;
+    char*               _map;
+    uint8_t*            _states;
+};
@@ -13,11 +13,59 @@
  limitations under the License.
 */
 
+#include <limits>
+
 #include "etl_image.hpp"
 
 using namespace std;
 using namespace nervana;
 
+// imdecode exposes libjpeg's scaled decoding from OpenCV 3.1 on
+#if !defined(CV_VERSION_EPOCH) && (CV_VERSION_MAJOR > 3 || (CV_VERSION_MAJOR == 3 && CV_VERSION_MINOR >= 1))
+#define HAS_REDUCED_DECODE 1
+#endif
+
+namespace
+{
+    bool jpeg_size(const char* data, int size, cv::Size2i& result)
+    {
+        // find the frame header of a JPEG without decoding it
+        const unsigned char* p = (const unsigned char*) data;
+        if (size < 4 || p[0] != 0xFF || p[1] != 0xD8) {
+            return false;
+        }
+        int pos = 2;
+        while (pos + 4 <= size) {
+            if (p[pos] != 0xFF) {
+                return false;
+            }
+            int marker = p[pos + 1];
+            if (marker == 0xFF) {
+                // fill byte
+                pos++;
+                continue;
+            }
+            if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD8)) {
+                // markers without a length
+                pos += 2;
+                continue;
+            }
+            int length = (p[pos + 2] << 8) | p[pos + 3];
+            if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+                // start of frame: precision, height, width
+                if (pos + 9 > size) {
+                    return false;
+                }
+                result.height = (p[pos + 5] << 8) | p[pos + 6];
+                result.width  = (p[pos + 7] << 8) | p[pos + 8];
+                return result.area() > 0;
+            }
+            pos += 2 + length;
+        }
+        return false;
+    }
+}
+
 image::config::config(nlohmann::json js)
 {
     if(js.is_null()) {
@@ -75,6 +123,7 @@ void image::params::dump(ostream & ostr)
 
 /* Extract */
 image::extractor::extractor(const image::config& cfg)
+: _cfg(cfg)
 {
     if (!(cfg.channels == 1 || cfg.channels == 3))
     {
@@ -94,13 +143,75 @@ shared_ptr<image::decoded> image::extractor::extract(const char* inbuf, int insi
     // It is bad to cast away const, but opencv does not support a const Mat
     // The Mat is only used for imdecode on the next line so it is OK here
     cv::Mat input_img(1, insize, _pixel_type, const_cast<char*>(inbuf));
-    cv::imdecode(input_img, _color_mode, &output_img);
+
+    cv::Size2i source_size;
+    int factor = 1;
+    if (_cfg.reduced_decode && jpeg_size(inbuf, insize, source_size)) {
+        // imdecode applies the EXIF orientation, which may swap width and
+        // height, so the factor has to be safe for either orientation
+        cv::Size2i transposed(source_size.height, source_size.width);
+        factor = min(reduction(source_size), reduction(transposed));
+    }
+
+#if HAS_REDUCED_DECODE
+    if (factor > 1) {
+        int mode;
+        if (_color_mode == CV_LOAD_IMAGE_COLOR) {
+            mode = factor == 8 ? cv::IMREAD_REDUCED_COLOR_8 :
+                   factor == 4 ? cv::IMREAD_REDUCED_COLOR_4 : cv::IMREAD_REDUCED_COLOR_2;
+        } else {
+            mode = factor == 8 ? cv::IMREAD_REDUCED_GRAYSCALE_8 :
+                   factor == 4 ? cv::IMREAD_REDUCED_GRAYSCALE_4 : cv::IMREAD_REDUCED_GRAYSCALE_2;
+        }
+        cv::imdecode(input_img, mode, &output_img);
+        cv::Size2i reduced((source_size.width + factor - 1) / factor,
+                           (source_size.height + factor - 1) / factor);
+        if (output_img.size() != reduced &&
+            output_img.size() == cv::Size2i(reduced.height, reduced.width)) {
+            // rotated by the EXIF orientation
+            source_size = cv::Size2i(source_size.height, source_size.width);
+        }
+    }
+#endif
+    if (output_img.empty()) {
+        cv::imdecode(input_img, _color_mode, &output_img);
+        source_size = output_img.size();
+    }
 
     auto rc = make_shared<image::decoded>();
     rc->add(output_img);    // don't need to check return for single image
+    rc->set_source_size(source_size);
     return rc;
 }
 
+int image::extractor::reduction(const cv::Size2i& source_size)
+{
+    // The smallest crop the param_factory can pick comes from the extremes
+    // of scale and horizontal_distortion.  Decode at 1/factor only if that
+    // crop still has at least as many pixels as the output in each
+    // direction.
+    float smallest = numeric_limits<float>::max();
+    for (float scale : {_cfg.scale.a(), _cfg.scale.b()}) {
+        for (float distortion : {_cfg.horizontal_distortion.a(), _cfg.horizontal_distortion.b()}) {
+            cv::Size2f out_shape(_cfg.width * distortion, _cfg.height);
+            cv::Size2f crop = cropbox_max_proportional(source_size, out_shape);
+            if (_cfg.do_area_scale) {
+                crop = cropbox_area_scale(source_size, crop, scale);
+            } else {
+                crop = cropbox_linear_scale(crop, scale);
+            }
+            smallest = min(smallest, min(crop.width / _cfg.width, crop.height / _cfg.height));
+        }
+    }
+
+    for (int factor : {8, 4, 2}) {
+        if (smallest >= factor) {
+            return factor;
+        }
+    }
+    return 1;
+}
+
 
 /* Transform:
     image::config will be a supplied bunch of params used by this provider.
@@ -127,7 +238,8 @@ shared_ptr<image::decoded> image::transformer::transform(
 {
     vector<cv::Mat> finalImageList;
     for(int i=0; i<img->get_image_count(); i++) {
-        finalImageList.push_back(transform_single_image(img_xform, img->get_image(i)));
+        finalImageList.push_back(transform_single_image(img_xform, img->get_image(i),
+                                                        img->get_source_size()));
     }
 
     auto rc = make_shared<image::decoded>();
@@ -139,20 +251,36 @@ shared_ptr<image::decoded> image::transformer::transform(
 
 cv::Mat image::transformer::transform_single_image(
                                             shared_ptr<image::params> img_xform,
-                                            cv::Mat& single_img)
+                                            cv::Mat& single_img,
+                                            const cv::Size2i& source_size)
 {
-    cv::Mat rotatedImage;
-    image::rotate(single_img, rotatedImage, img_xform->angle);
-    cv::Mat croppedImage = rotatedImage(img_xform->cropbox);
+    // the cropbox is in source pixels, bring it to the decoded image's
+    cv::Rect cropbox = img_xform->cropbox;
+    if (source_size.area() > 0 && source_size != single_img.size()) {
+        float sx = float(single_img.cols) / source_size.width;
+        float sy = float(single_img.rows) / source_size.height;
+        cropbox = cv::Rect(cropbox.x * sx, cropbox.y * sy, cropbox.width * sx, cropbox.height * sy);
+        cropbox &= cv::Rect(0, 0, single_img.cols, single_img.rows);
+    }
 
     cv::Mat resizedImage;
-    image::resize(croppedImage, resizedImage, img_xform->output_size);
+    bool flipped = false;
+    if (img_xform->angle == 0) {
+        // the crop is only a view, so resizing is the one pass over the pixels
+        image::resize(single_img(cropbox), resizedImage, img_xform->output_size);
+    } else {
+        // rather than rotating the whole image first, sample the rotated,
+        // cropped, resized and flipped output directly
+        image::rotate_crop_resize(single_img, resizedImage, img_xform->angle, cropbox,
+                                  img_xform->output_size, img_xform->flip);
+        flipped = img_xform->flip;
+    }
     photo.cbsjitter(resizedImage, img_xform->photometric);
     photo.lighting(resizedImage, img_xform->lighting, img_xform->color_noise_std);
 
     cv::Mat *finalImage = &resizedImage;
     cv::Mat flippedImage;
-    if (img_xform->flip) {
+    if (img_xform->flip && !flipped) {
         cv::flip(resizedImage, flippedImage, 1);
         finalImage = &flippedImage;
     }
@@ -172,7 +300,7 @@ image::param_factory::make_params(shared_ptr<const decoded> input)
     settings->angle = _cfg.angle(_dre);
     settings->flip  = _cfg.flip_distribution(_dre);
 
-    cv::Size2f in_size = input->get_image_size();
+    cv::Size2f in_size = input->get_source_size();
 
     float scale = _cfg.scale(_dre);
     float horizontal_distortion = _cfg.horizontal_distortion(_dre);
@@ -217,6 +345,11 @@ void image::loader::load(const std::vector<void*>& outlist, shared_ptr<image::de
     for (int i=0; i < input->get_image_count(); i++) {
         auto outbuf_i = outbuf + (i * image_size);
         img = input->get_image(i);
+        if (img.depth() == CV_8U && img.channels() == _cfg.channels) {
+            image::convert_8u(img, outbuf_i, cv_type, _cfg.channel_major);
+            continue;
+        }
+
         vector<cv::Mat> source;
         vector<cv::Mat> target;
         vector<int>     from_to;
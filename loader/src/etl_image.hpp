@@ -77,6 +77,10 @@ namespace nervana {
         bool                                  channel_major = true;
         uint32_t                              channels = 3;
 
+        /** Let libjpeg decode JPEGs at 1/2, 1/4 or 1/8 size when every crop
+            the params can pick still covers the output at that size */
+        bool                                  reduced_decode = false;
+
         /** Scale the image (width, height) */
         std::uniform_real_distribution<float> scale{1.0f, 1.0f};
 
@@ -117,7 +121,8 @@ namespace nervana {
             ADD_SCALAR(type_string, mode::OPTIONAL, [](const std::string& v){ return output_type::is_valid_type(v); }),
             ADD_SCALAR(do_area_scale, mode::OPTIONAL),
             ADD_SCALAR(channel_major, mode::OPTIONAL),
-            ADD_SCALAR(channels, mode::OPTIONAL, [](uint32_t v){ return v==1 || v==3; })
+            ADD_SCALAR(channels, mode::OPTIONAL, [](uint32_t v){ return v==1 || v==3; }),
+            ADD_SCALAR(reduced_decode, mode::OPTIONAL)
         };
 
         config() {}
@@ -169,6 +174,13 @@ namespace nervana {
 
         cv::Mat& get_image(int index) { return _images[index]; }
         cv::Size2i get_image_size() const {return _images[0].size(); }
+
+        // size of the encoded image, which params are computed against.  It
+        // differs from the image size when the image was decoded reduced.
+        cv::Size2i get_source_size() const {
+            return _source_size.area() > 0 ? _source_size : get_image_size();
+        }
+        void set_source_size(const cv::Size2i& size) { _source_size = size; }
         int get_image_channels() const { return _images[0].channels(); }
         size_t get_image_count() const { return _images.size(); }
         size_t get_size() const {
@@ -183,6 +195,7 @@ namespace nervana {
             return true;
         }
         std::vector<cv::Mat> _images;
+        cv::Size2i           _source_size;
     };
 
 
@@ -195,6 +208,9 @@ namespace nervana {
 
         const int get_channel_count() {return _color_mode == CV_LOAD_IMAGE_COLOR ? 3 : 1;}
     private:
+        int reduction(const cv::Size2i& source_size);
+
+        const image::config& _cfg;
         int _pixel_type;
         int _color_mode;
     };
@@ -208,7 +224,10 @@ namespace nervana {
                                                 std::shared_ptr<image::params>,
                                                 std::shared_ptr<image::decoded>) override;
 
-        cv::Mat transform_single_image(std::shared_ptr<image::params>, cv::Mat&);
+        // source_size is the size the params' cropbox refers to, if the
+        // image was decoded at a reduced size
+        cv::Mat transform_single_image(std::shared_ptr<image::params>, cv::Mat&,
+                                       const cv::Size2i& source_size = cv::Size2i());
     private:
         photometric photo;
     };
@@ -81,7 +81,7 @@ shared_ptr<image::decoded> multicrop::transformer::transform(
                                                 shared_ptr<image::params> crop_settings,
                                                 shared_ptr<image::decoded> input)
 {
-    cv::Size2i in_size = input->get_image_size();
+    cv::Size2i in_size = input->get_source_size();
     auto cropbox_size = image::cropbox_max_proportional(in_size, crop_settings->output_size);
 
     vector<cv::Rect> cropboxes;
@@ -102,7 +102,8 @@ shared_ptr<image::decoded> multicrop::transformer::transform(
         for (auto orientation: _orientations) {
             crop_settings->flip = orientation;
             bool add_ok = out_imgs->add(
-                    _crop_transformer.transform_single_image(crop_settings, input->get_image(0))
+                    _crop_transformer.transform_single_image(crop_settings, input->get_image(0),
+                                                             in_size)
                 );
             if (!add_ok) {
                 return nullptr;
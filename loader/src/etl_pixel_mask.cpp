@@ -63,18 +63,23 @@ std::shared_ptr<image::decoded> pixel_mask::transformer::transform(
 {
     if(image_list->get_image_count() != 1) throw invalid_argument("pixel_mask transform only supports a single image");
 
-    cv::Mat rotatedImage;
-    cv::Scalar border{0,0,0};
-    image::rotate(image_list->get_image(0), rotatedImage, img_xform->angle, false, border);
-
-    cv::Mat croppedImage = rotatedImage(img_xform->cropbox);
-
+    cv::Mat& mask = image_list->get_image(0);
     cv::Mat resizedImage;
-    image::resize(croppedImage, resizedImage, img_xform->output_size, false);
+    bool flipped = false;
+    if (img_xform->angle == 0) {
+        image::resize(mask(img_xform->cropbox), resizedImage, img_xform->output_size, false);
+    } else {
+        // same single pass mapping as the image transformer, without
+        // interpolation so the output only holds values from the mask
+        cv::Scalar border{0,0,0};
+        image::rotate_crop_resize(mask, resizedImage, img_xform->angle, img_xform->cropbox,
+                                  img_xform->output_size, img_xform->flip, false, border);
+        flipped = img_xform->flip;
+    }
 
     cv::Mat *finalImage = &resizedImage;
     cv::Mat flippedImage;
-    if (img_xform->flip) {
+    if (img_xform->flip && !flipped) {
         cv::flip(resizedImage, flippedImage, 1);
         finalImage = &flippedImage;
     }
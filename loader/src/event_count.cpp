@@ -0,0 +1,60 @@
+/*
+ Copyright 2016 Nervana Systems Inc.
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include <climits>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "event_count.hpp"
+
+using namespace std;
+using namespace nervana;
+
+void event_count::notify_all()
+{
+    // order the caller's update before the waiter count is read, pairing
+    // with the increment in wait()
+    atomic_thread_fence(memory_order_seq_cst);
+    if (_waiters.load() == 0) {
+        return;
+    }
+#ifdef __linux__
+    _epoch.fetch_add(1);
+    syscall(SYS_futex, &_epoch, FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+#else
+    {
+        lock_guard<mutex> lock(_mutex);
+        _epoch.fetch_add(1);
+    }
+    _cond.notify_all();
+#endif
+}
+
+void event_count::sleep(uint32_t key)
+{
+#ifdef __linux__
+    // returns at once if the epoch has already moved on
+    syscall(SYS_futex, &_epoch, FUTEX_WAIT_PRIVATE, key, nullptr, nullptr, 0);
+#else
+    unique_lock<mutex> lock(_mutex);
+    while (_epoch.load() == key) {
+        _cond.wait(lock);
+    }
+#endif
+}
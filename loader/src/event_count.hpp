@@ -0,0 +1,73 @@
+/*
+ Copyright 2016 Nervana Systems Inc.
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <condition_variable>
+
+namespace nervana {
+    class event_count;
+}
+
+/* event_count
+ *
+ * Lets threads sleep until a condition on lock-free state holds without
+ * guarding that state with a mutex.  A waiter registers, checks its
+ * condition and only then sleeps on the current epoch; notify_all bumps
+ * the epoch, so a change made between the check and the sleep is never
+ * missed.  notify_all costs a couple of atomics when nobody waits and a
+ * futex wake on Linux when somebody does.
+ *
+ */
+class nervana::event_count {
+public:
+    event_count() {}
+
+    // block until pred() is true
+    template<typename Pred>
+    void wait(Pred pred)
+    {
+        while (!pred()) {
+            _waiters.fetch_add(1);
+            uint32_t key = _epoch.load();
+            if (pred()) {
+                _waiters.fetch_sub(1);
+                return;
+            }
+            sleep(key);
+            _waiters.fetch_sub(1);
+        }
+    }
+
+    // wake every waiter so it checks its condition again.  Call after the
+    // state the condition reads has been updated.
+    void notify_all();
+
+private:
+    event_count(const event_count&) = delete;
+    event_count& operator=(const event_count&) = delete;
+
+    void sleep(uint32_t key);
+
+    std::atomic<uint32_t>   _epoch{0};
+    std::atomic<int>        _waiters{0};
+#ifndef __linux__
+    std::mutex              _mutex;
+    std::condition_variable _cond;
+#endif
+};
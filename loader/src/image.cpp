@@ -14,6 +14,16 @@
 */
 
 #include <iostream>
+#include <limits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <tmmintrin.h>
+#define HAS_SSSE3_CONVERT
+#endif
 
 #include "image.hpp"
 #include "util.hpp"
@@ -21,6 +31,153 @@
 using namespace nervana;
 using namespace std;
 
+namespace {
+    // Scalar kernels for converting one row of an interleaved 8 bit image,
+    // either into planes of plane elements each or left interleaved.  They
+    // saturate the same way cv::Mat::convertTo does.
+    template<typename T>
+    void planar_row(const uint8_t* src, int cols, int channels, T* dst, size_t plane, int col = 0)
+    {
+        for (; col < cols; col++) {
+            for (int ch = 0; ch < channels; ch++) {
+                dst[ch * plane + col] = cv::saturate_cast<T>(src[col * channels + ch]);
+            }
+        }
+    }
+
+    template<typename T>
+    void interleaved_row(const uint8_t* src, int count, T* dst, int i = 0)
+    {
+        for (; i < count; i++) {
+            dst[i] = cv::saturate_cast<T>(src[i]);
+        }
+    }
+
+#ifdef HAS_SSSE3_CONVERT
+    bool has_ssse3()
+    {
+        static bool rc = __builtin_cpu_supports("ssse3");
+        return rc;
+    }
+
+    __attribute__((target("ssse3")))
+    inline void store(uint8_t* dst, __m128i v)
+    {
+        _mm_storeu_si128((__m128i*)dst, v);
+    }
+
+    __attribute__((target("ssse3")))
+    inline void store(float* dst, __m128i v)
+    {
+        __m128i zero = _mm_setzero_si128();
+        __m128i lo = _mm_unpacklo_epi8(v, zero);
+        __m128i hi = _mm_unpackhi_epi8(v, zero);
+        _mm_storeu_ps(dst,      _mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)));
+        _mm_storeu_ps(dst + 4,  _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)));
+        _mm_storeu_ps(dst + 8,  _mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)));
+        _mm_storeu_ps(dst + 12, _mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)));
+    }
+
+    // 16 pixels of 3 channels span three registers.  shuffle[ch][k] picks
+    // the bytes of channel ch that are in register k, zeroing the rest, so
+    // or-ing the three shuffles gives the channel's 16 bytes in order.
+    struct bgr_shuffle {
+        bgr_shuffle()
+        {
+            for (int ch = 0; ch < 3; ch++) {
+                for (int k = 0; k < 3; k++) {
+                    for (int i = 0; i < 16; i++) {
+                        int index = 3 * i + ch;
+                        bytes[ch][k][i] = index / 16 == k ? index % 16 : -1;
+                    }
+                }
+            }
+        }
+        int8_t bytes[3][3][16];
+    };
+
+    template<typename T>
+    __attribute__((target("ssse3")))
+    void planar_bgr_ssse3(const uint8_t* src, int cols, T* dst, size_t plane)
+    {
+        static const bgr_shuffle table;
+        __m128i shuffle[3][3];
+        for (int ch = 0; ch < 3; ch++) {
+            for (int k = 0; k < 3; k++) {
+                shuffle[ch][k] = _mm_loadu_si128((const __m128i*)table.bytes[ch][k]);
+            }
+        }
+
+        int col = 0;
+        for (; col + 16 <= cols; col += 16) {
+            __m128i a = _mm_loadu_si128((const __m128i*)(src + col * 3));
+            __m128i b = _mm_loadu_si128((const __m128i*)(src + col * 3 + 16));
+            __m128i c = _mm_loadu_si128((const __m128i*)(src + col * 3 + 32));
+            for (int ch = 0; ch < 3; ch++) {
+                __m128i v = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, shuffle[ch][0]),
+                                                      _mm_shuffle_epi8(b, shuffle[ch][1])),
+                                         _mm_shuffle_epi8(c, shuffle[ch][2]));
+                store(dst + ch * plane + col, v);
+            }
+        }
+        planar_row(src, cols, 3, dst, plane, col);
+    }
+
+    __attribute__((target("ssse3")))
+    void interleaved_ssse3(const uint8_t* src, int count, float* dst)
+    {
+        int i = 0;
+        for (; i + 16 <= count; i += 16) {
+            store(dst + i, _mm_loadu_si128((const __m128i*)(src + i)));
+        }
+        interleaved_row(src, count, dst, i);
+    }
+#endif
+
+    template<typename T>
+    void convert_rows(const cv::Mat& input, T* output, bool channel_major)
+    {
+        int channels = input.channels();
+        size_t plane = input.total();
+        for (int row = 0; row < input.rows; row++) {
+            const uint8_t* src = input.ptr<uint8_t>(row);
+            size_t offset = size_t(row) * input.cols;
+            if (channel_major) {
+                planar_row(src, input.cols, channels, output + offset, plane);
+            } else {
+                interleaved_row(src, input.cols * channels, output + offset * channels);
+            }
+        }
+    }
+
+    // uint8_t and float are what nearly every dataset asks for, so those get
+    // the SIMD kernels where the cpu has them
+    template<typename T>
+    void convert_rows_simd(const cv::Mat& input, T* output, bool channel_major)
+    {
+#ifdef HAS_SSSE3_CONVERT
+        if (has_ssse3()) {
+            size_t plane = input.total();
+            for (int row = 0; row < input.rows; row++) {
+                const uint8_t* src = input.ptr<uint8_t>(row);
+                size_t offset = size_t(row) * input.cols;
+                if (channel_major && input.channels() == 3) {
+                    planar_bgr_ssse3(src, input.cols, output + offset, plane);
+                } else if (channel_major) {
+                    planar_row(src, input.cols, input.channels(), output + offset, plane);
+                } else if (is_same<T, float>::value) {
+                    interleaved_ssse3(src, input.cols * input.channels(), (float*)output + offset * input.channels());
+                } else {
+                    memcpy(output + offset * input.channels(), src, input.cols * input.channels());
+                }
+            }
+            return;
+        }
+#endif
+        convert_rows(input, output, channel_major);
+    }
+}
+
 void image::rotate(const cv::Mat& input, cv::Mat& output, int angle, bool interpolate, const cv::Scalar& border)
 {
     if (angle == 0) {
@@ -53,6 +210,90 @@ void image::resize(const cv::Mat& input, cv::Mat& output, const cv::Size2i& size
     }
 }
 
+void image::rotate_crop_resize(const cv::Mat& input, cv::Mat& output, int angle, const cv::Rect& cropbox,
+                               const cv::Size2i& size, bool flip, bool interpolate, const cv::Scalar& border)
+{
+    // Build the map from output pixels back to input pixels.  Output pixel
+    // centers are spread over the cropbox the way cv::resize does, after
+    // undoing the flip.
+    double sx = double(cropbox.width) / size.width;
+    double sy = double(cropbox.height) / size.height;
+    cv::Matx33d to_crop(sx, 0,  cropbox.x + 0.5 * sx - 0.5,
+                        0,  sy, cropbox.y + 0.5 * sy - 0.5,
+                        0,  0,  1);
+    if (flip) {
+        to_crop = to_crop * cv::Matx33d(-1, 0, size.width - 1,
+                                         0, 1, 0,
+                                         0, 0, 1);
+    }
+
+    // the cropbox is in rotated image coordinates, which image::rotate
+    // produces with this matrix
+    cv::Point2i pt(input.cols / 2, input.rows / 2);
+    cv::Mat rot = cv::getRotationMatrix2D(pt, angle, 1.0);
+    cv::Matx33d rotation(rot.at<double>(0, 0), rot.at<double>(0, 1), rot.at<double>(0, 2),
+                         rot.at<double>(1, 0), rot.at<double>(1, 1), rot.at<double>(1, 2),
+                         0, 0, 1);
+    cv::Matx33d to_input = rotation.inv() * to_crop;
+
+    // Bilinear sampling skips input pixels once the output shrinks by more
+    // than 2x, so area average the part of the input the output covers
+    // down to within 2x first.
+    cv::Mat source = input;
+    int shrink = std::min(sx, sy);
+    if (interpolate && shrink >= 2) {
+        float x0 = numeric_limits<float>::max(), y0 = x0, x1 = -x0, y1 = -x0;
+        for (cv::Point2d corner : {cv::Point2d(-0.5, -0.5), cv::Point2d(size.width - 0.5, -0.5),
+                                   cv::Point2d(-0.5, size.height - 0.5), cv::Point2d(size.width - 0.5, size.height - 0.5)}) {
+            cv::Vec3d p = to_input * cv::Vec3d(corner.x, corner.y, 1);
+            x0 = min<float>(x0, p[0]);
+            y0 = min<float>(y0, p[1]);
+            x1 = max<float>(x1, p[0]);
+            y1 = max<float>(y1, p[1]);
+        }
+        cv::Rect region(cv::Point2i(floor(x0) - 1, floor(y0) - 1), cv::Point2i(ceil(x1) + 2, ceil(y1) + 2));
+        region &= cv::Rect(0, 0, input.cols, input.rows);
+        if (region.width >= shrink && region.height >= shrink) {
+            cv::resize(input(region), source, cv::Size2i(region.width / shrink, region.height / shrink),
+                       0, 0, CV_INTER_AREA);
+            double fx = double(region.width) / source.cols;
+            double fy = double(region.height) / source.rows;
+            cv::Matx33d to_source(1 / fx, 0,      (0.5 - region.x) / fx - 0.5,
+                                  0,      1 / fy, (0.5 - region.y) / fy - 0.5,
+                                  0,      0,      1);
+            to_input = to_source * to_input;
+            sx /= fx;
+            sy /= fy;
+        }
+    }
+
+    int flags;
+    if (interpolate) {
+        flags = sx < 1 || sy < 1 ? cv::INTER_CUBIC : cv::INTER_LINEAR;
+    } else {
+        flags = cv::INTER_NEAREST;
+    }
+    cv::Matx23d map(to_input(0, 0), to_input(0, 1), to_input(0, 2),
+                    to_input(1, 0), to_input(1, 1), to_input(1, 2));
+    cv::warpAffine(source, output, map, size, flags | cv::WARP_INVERSE_MAP, cv::BORDER_CONSTANT, border);
+}
+
+void image::convert_8u(const cv::Mat& input, char* output, int cv_type, bool channel_major)
+{
+    if (input.depth() != CV_8U) throw invalid_argument("convert_8u input must be 8 bit");
+
+    switch (CV_MAT_DEPTH(cv_type)) {
+    case CV_8U:  convert_rows_simd(input, (uint8_t*)output, channel_major); break;
+    case CV_8S:  convert_rows(input, (int8_t*)output, channel_major); break;
+    case CV_16U: convert_rows(input, (uint16_t*)output, channel_major); break;
+    case CV_16S: convert_rows(input, (int16_t*)output, channel_major); break;
+    case CV_32S: convert_rows(input, (int32_t*)output, channel_major); break;
+    case CV_32F: convert_rows_simd(input, (float*)output, channel_major); break;
+    case CV_64F: convert_rows(input, (double*)output, channel_major); break;
+    default: throw invalid_argument("convert_8u unsupported output type");
+    }
+}
+
 void image::convert_mix_channels(vector<cv::Mat>& source, vector<cv::Mat>& target, vector<int>& from_to)
 {
     if(source.size() == 0) throw invalid_argument("convertMixChannels source size must be > 0");
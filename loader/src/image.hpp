@@ -25,6 +25,14 @@ namespace nervana {
         // These functions may be common across different transformers
         void resize(const cv::Mat&, cv::Mat&, const cv::Size2i&, bool interpolate=true);
         void rotate(const cv::Mat& input, cv::Mat& output, int angle, bool interpolate=true, const cv::Scalar& border=cv::Scalar());
+        // rotate like image::rotate, then crop, resize to size and optionally
+        // flip, sampling the output straight from input in one pass
+        void rotate_crop_resize(const cv::Mat& input, cv::Mat& output, int angle, const cv::Rect& cropbox,
+                                const cv::Size2i& size, bool flip, bool interpolate=true,
+                                const cv::Scalar& border=cv::Scalar());
+        // converts an interleaved 8 bit image to cv_type in one pass, writing
+        // output as planes when channel_major and interleaved otherwise
+        void convert_8u(const cv::Mat& input, char* output, int cv_type, bool channel_major);
         void convert_mix_channels(std::vector<cv::Mat>& source, std::vector<cv::Mat>& target, std::vector<int>& from_to);
 
         float calculate_scale(const cv::Size& size, int min_size, int max_size);
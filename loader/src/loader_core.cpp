@@ -0,0 +1,918 @@
+/*
+ Copyright 2016 Nervana Systems Inc.
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include <vector>
+#include <cstdio>
+#include <iostream>
+#include <chrono>
+#include <utility>
+#include <algorithm>
+#include <sstream>
+#include <fstream>
+#include <cstring>
+#include <thread>
+#include <iterator>
+
+#include "loader_core.hpp"
+#include "cpu.hpp"
+#include "stats.hpp"
+#include "block_loader_cpio_cache.hpp"
+#include "block_loader_async.hpp"
+#include "block_iterator_sampled.hpp"
+#include "block_iterator_sequential.hpp"
+#include "block_iterator_shuffled.hpp"
+#include "batch_iterator.hpp"
+#include "manifest_nds.hpp"
+#include "block_loader_nds.hpp"
+#include "log.hpp"
+#include "etl_label.hpp"
+
+using namespace std;
+using namespace nervana;
+
+decode_thread_pool::decode_thread_pool(int count,
+                                       const shared_ptr<buffer_pool_in>& in,
+                                       const shared_ptr<buffer_pool_out>& out,
+                                       const shared_ptr<nervana::backend>& be,
+                                       const shared_ptr<decoded_cache>& decoded) :
+    thread_pool(count),
+    _in(in),
+    _out(out),
+    _backend(be),
+    _decoded_cache(decoded),
+    _batchSize(out->get(0)[0]->get_item_count()),
+    _jobs(out->count()),
+    _active(count),
+    _finishQueue(out->count())
+{
+}
+
+void decode_thread_pool::set_depth(int depth)
+{
+    affirm(depth > 0 && depth < _out->count() && depth < _in->count(),
+           "decode depth must be less than the number of buffers");
+    _depth = depth;
+    // the manager may be waiting for room to decode another minibatch
+    _in->signal_not_empty();
+}
+
+void decode_thread_pool::set_active_threads(int count)
+{
+    affirm(count > 0 && count <= _count, "active decode threads out of range");
+    _active = count;
+    _started.notify_all();
+}
+
+void decode_thread_pool::skip_until(uint64_t n)
+{
+    uint64_t current = _skipUntil;
+    while (current < n && !_skipUntil.compare_exchange_weak(current, n)) {
+    }
+}
+
+void decode_thread_pool::add_provider(std::shared_ptr<nervana::provider_interface> prov)
+{
+    _providers.push_back(prov);
+}
+
+decode_thread_pool::~decode_thread_pool()
+{
+    if (_manager != 0) {
+        _manager->join();
+        delete _manager;
+    }
+    if (_finisher != 0) {
+        _finisher->join();
+        delete _finisher;
+    }
+    // Other thread objects are freed in the destructor of the parent class.
+}
+
+void decode_thread_pool::start()
+{
+    for (int i = 0; i < _count; i++) {
+        _threads.push_back(new thread(&decode_thread_pool::run, this, i));
+        cpu::pin(*_threads.back(), _cpus);
+    }
+    _finisher = new thread(&decode_thread_pool::finish, this);
+    cpu::pin(*_finisher, _managerCpus);
+    _manager = new thread(&decode_thread_pool::manage, this);
+    cpu::pin(*_manager, _managerCpus);
+}
+
+void decode_thread_pool::stop()
+{
+    // the manager may be waiting for input or for a free output buffer
+    _stopManager = true;
+    while (_managerStopped == false) {
+        std::this_thread::yield();
+        _in->signal_not_empty();
+        _out->signal_not_full();
+    }
+
+    thread_pool::stop();
+    _started.notify_all();
+    while (stopped() == false) {
+        std::this_thread::yield();
+    }
+
+    // the finisher may be waiting on a job the workers left unfinished
+    _stopFinisher = true;
+    _finishReady.notify_all();
+    _ended.notify_all();
+}
+
+void decode_thread_pool::run(int id)
+{
+    try {
+        affirm(id < _count, "id < _count");
+
+        while (_done == false) {
+            work(id);
+        }
+
+        _stopped[id] = true;
+    } catch (std::exception& e) {
+        cerr << "fatal exception in decode_thread_pool::run: " << e.what() << endl;
+        // TODO: fail gracefully, not seg fault
+    }
+}
+
+void decode_thread_pool::work(int id)
+{
+    // Thread function.  Decodes one record.  No locking required because
+    // each record is claimed by exactly one thread, and claiming them one
+    // at a time keeps every thread busy however uneven the records are.
+    // Idle threads wait until they are active and there is work.
+    _started.wait([&]() {
+        return _done || (id < _active && _nextItem < _dispatched * _batchSize);
+    });
+    if (_done) {
+        return;
+    }
+
+    // another thread may have claimed the last record handed out, so this
+    // one can belong to a minibatch still to come
+    uint64_t item = _nextItem++;
+    uint64_t n = item / _batchSize;
+    _started.wait([&]() { return _done || n < _dispatched; });
+    if (_done) {
+        return;
+    }
+
+    job& j = _jobs[n % _jobs.size()];
+    int i = item % _batchSize;
+    if (j.skip) {
+        // its minibatch is going to be thrown away, it only needs counting
+        if (--j.remaining == 0) {
+            _ended.notify_all();
+        }
+        return;
+    }
+    try {
+        affirm((*j.input)[0]->get_item_count() != 0, "input buffer to decoded_thread_pool is empty");
+
+        stats::timer timer(stats::stage::record);
+        if (_decoded_cache) {
+            int64_t record = (*j.input)[0]->get_record(i);
+            if (!_decoded_cache->load(record, *j.output, i)) {
+                _providers[id]->provide(i, *j.input, *j.output);
+                _decoded_cache->store(record, *j.output, i);
+            }
+        } else {
+            _providers[id]->provide(i, *j.input, *j.output);
+        }
+    } catch (std::exception& e) {
+        cout << "decode_thread_pool exception: " << e.what() << endl;
+        // error is only read once remaining reaches zero below
+        if (j.failed.exchange(true) == false) {
+            j.error = std::current_exception();
+        }
+    }
+
+    if (--j.remaining == 0) {
+        _ended.notify_all();
+    }
+}
+
+void decode_thread_pool::produce()
+{
+    // reserve an output buffer.  Buffers still waiting on the finisher count
+    // as used, so this only waits when the consumer has fallen behind.
+    _out->wait_for_non_full([this]() { return _stopManager.load(); });
+    if (_stopManager == true) {
+        return;
+    }
+
+    // the job is filled in before _dispatched moves past it, which is what
+    // the workers wait for.  The finisher takes jobs in the same order.
+    uint64_t n = _dispatched;
+    int slot = n % _jobs.size();
+    job& j = _jobs[slot];
+    j.input = &_in->get(_inputIndex);
+    j.outputIndex = _out->reserve_for_write();
+    j.output = &_out->get(j.outputIndex);
+    j.skip = n < _skipUntil;
+    j.failed = false;
+    j.error = nullptr;
+    j.remaining = _batchSize;
+    if (++_inputIndex == _in->count()) {
+        _inputIndex = 0;
+    }
+
+    affirm(_finishQueue.try_push(slot), "decode_thread_pool finish queue full");
+    _finishReady.notify_all();
+    _dispatched++;
+    _started.notify_all();
+}
+
+void decode_thread_pool::consume()
+{
+    // wait for a read buffer that isn't being decoded yet and room for
+    // another job.  The reader keeps filling the other input buffers meanwhile.
+    uint64_t waiting = stats::now();
+    _in->wait_until([this]() {
+        int decoding = _dispatched - _released;
+        return _stopManager || (decoding < _depth && _in->used() > decoding &&
+                                _dispatched - _retired < _jobs.size());
+    });
+    _inputWaitNs += stats::now() - waiting;
+    if (_stopManager == true) {
+        return;
+    }
+    produce();
+}
+
+void decode_thread_pool::manage()
+{
+    try {
+        // Thread function.
+        while (_stopManager == false) {
+            consume();
+        }
+    } catch (std::exception& e) {
+        cerr << "exception in decode_thread_pool::manage: " << e.what() << endl;
+        // TODO: fail gracefully, not seg fault
+    }
+    _managerStopped = true;
+}
+
+void decode_thread_pool::finish()
+{
+    // Thread function.  Jobs are finished in the order they were handed
+    // out, which is also the order their buffers were reserved in.
+    while (true) {
+        int slot;
+        _finishReady.wait([this]() { return _finishQueue.empty() == false || _stopFinisher; });
+        if (_stopFinisher == true) {
+            return;
+        }
+        _finishQueue.try_pop(slot);
+        job& j = _jobs[slot];
+        _ended.wait([&]() { return j.remaining == 0 || _stopFinisher; });
+        if (_stopFinisher == true) {
+            return;
+        }
+
+        // the read buffer is free as soon as the job is decoded, so the
+        // manager can hand out the next one during post_process and the
+        // transfer.  It waits for that on the input pool's not empty signal.
+        _in->advance_read_pos();
+        _in->signal_not_full();
+        _released++;
+        _in->signal_not_empty();
+
+        if (j.error) {
+            _out->write_exception(j.error, j.outputIndex);
+            j.error = nullptr;
+        }
+
+        // a minibatch that is going to be thrown away is left as it is
+        if (j.skip == false) {
+            try {
+                buffer_out_array& outBuf = *j.output;
+                stats::split split;
+
+                // Do any messy cross datum stuff you may need to do that requires minibatch consistency
+                _providers[0]->post_process(outBuf);
+                split.mark(stats::stage::post_process);
+
+                // Copy to device.
+                if (_backend) {
+                    _backend->call_backend_transfer(outBuf, j.outputIndex);
+                }
+                split.mark(stats::stage::backend_transfer);
+            } catch (std::exception& e) {
+                cout << "exception in provider post_process/call to backend transfer: " << e.what();
+            }
+        }
+
+        _out->advance_write_pos();
+        _out->signal_not_empty();
+        _retired++;
+        _in->signal_not_empty();
+    }
+}
+
+
+read_thread_pool::read_thread_pool(const shared_ptr<buffer_pool_in>& out,
+                       const shared_ptr<batch_iterator>& b_it) :
+    thread_pool(1),
+    _out(out),
+    _batch_iterator(b_it)
+{
+    affirm(_count == 1, "thread pool count > 1");
+    _states.push_back(_batch_iterator->get_state());
+}
+
+void read_thread_pool::work(int id)
+{
+    // Fill input buffers.  The buffer being filled belongs to this thread
+    // alone until advance_write_pos hands it over.
+    _out->wait_for_non_full();
+
+    unique_lock<mutex> lock(_mutex);
+    uint tries = 0;
+    while(tries < 3) {
+        try {
+            tries += 1;
+            stats::timer timer(stats::stage::batch_read);
+            _batch_iterator->read(_out->get_for_write());
+            break;
+        } catch(std::exception& e) {
+            cout << "read_thread_pool exception:" << e.what() << endl;
+            _out->write_exception(std::current_exception());
+        }
+    }
+    if(tries == 3) {
+        cout << "tried reading 3 times and failed.  Giving up";
+        throw std::runtime_error("tried 3 times to read from batch_iterator and failed each time.");
+    }
+
+    _batchesRead++;
+    _states.push_back(_batch_iterator->get_state());
+    while (_states.size() > _keep + 1) {
+        _states.pop_front();
+    }
+    lock.unlock();
+
+    _out->advance_write_pos();
+    _out->signal_not_empty();
+}
+
+uint64_t read_thread_pool::restart(const nlohmann::json& state)
+{
+    lock_guard<mutex> lock(_mutex);
+    if (state.is_null()) {
+        _batch_iterator->reset();
+    } else {
+        _batch_iterator->set_state(state);
+    }
+    _states.back() = _batch_iterator->get_state();
+    return _batchesRead;
+}
+
+nlohmann::json read_thread_pool::state(uint64_t n)
+{
+    lock_guard<mutex> lock(_mutex);
+    uint64_t first = _batchesRead + 1 - _states.size();
+    affirm(n >= first && n <= _batchesRead, "iterator state is no longer kept");
+    return _states[n - first];
+}
+
+namespace {
+    // the label of every record in manifest, read from its target file the
+    // way the label provider reads it.  There is a file per record, so
+    // several threads read them.
+    vector<string> read_labels(const manifest_csv& manifest, const nlohmann::json& config)
+    {
+        label::config label_config(config);
+        size_t count = manifest.objectCount();
+        size_t thread_count = std::min<size_t>(cpu::available(), count);
+        vector<string> labels(count);
+        vector<exception_ptr> errors(thread_count);
+        vector<thread> threads;
+        for (size_t t = 0; t < thread_count; ++t) {
+            threads.emplace_back([&, t] {
+                try {
+                    label::extractor extractor(label_config);
+                    for (size_t i = t; i < count; i += thread_count) {
+                        const string& filename = manifest.begin()[i].back();
+                        ifstream in(filename, ios::binary);
+                        if (!in) {
+                            throw std::runtime_error("could not read target file " + filename);
+                        }
+                        string contents((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+                        labels[i] = to_string(extractor.extract(contents.data(), contents.size())->get_index());
+                    }
+                } catch (std::exception&) {
+                    errors[t] = current_exception();
+                }
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        for (auto& e : errors) {
+            if (e) {
+                rethrow_exception(e);
+            }
+        }
+        return labels;
+    }
+}
+
+loader_core::loader_core(const string& cfg_string)
+{
+    _lcfg_json = nlohmann::json::parse(cfg_string);
+    loader_config lcfg(_lcfg_json);
+
+    _batchSize = lcfg.minibatch_size;
+    _read_buffer_count = lcfg.read_buffer_count;
+    _decode_buffer_count = lcfg.decode_buffer_count;
+    _single_thread_mode = lcfg.single_thread;
+    _decode_thread_count = lcfg.decode_thread_count;
+    _defer_transfer = lcfg.defer_transfer;
+    _autotune = lcfg.autotune && !lcfg.single_thread;
+    _autotune_batches = lcfg.autotune_batches;
+
+    // a NUMA node supplies the cpus of any thread group without a list
+    if(lcfg.numa_node >= 0) {
+        _node_cpus = cpu::node(lcfg.numa_node);
+    }
+    auto cpus = [&](const string& list) {
+        return list.empty() ? _node_cpus : cpu::parse_list(list);
+    };
+    _decode_cpus = cpus(lcfg.decode_thread_cpus);
+    _read_cpus = cpus(lcfg.read_thread_cpus);
+    _manager_cpus = cpus(lcfg.manager_thread_cpus);
+    shared_ptr<nervana::manifest> base_manifest = nullptr;
+    string cache_suffix;
+    vector<float> weights;
+
+    if(nervana::manifest_nds::is_likely_json(lcfg.manifest_filename)) {
+        affirm(lcfg.subset_fraction == 1, "subset_fraction must be 1.0 for nds");
+        affirm(lcfg.sample_weights.empty(), "sample_weights needs a csv manifest");
+
+        auto manifest = make_shared<nervana::manifest_nds>(lcfg.manifest_filename);
+
+        // the server shards the collection itself and numbers the blocks
+        // of each shard from 0
+        _block_loader = make_shared<block_loader_nds>(manifest->baseurl,
+                                                      manifest->token,
+                                                      manifest->collection_id,
+                                                      lcfg.macrobatch_size,
+                                                      lcfg.shard_count,
+                                                      lcfg.shard_index);
+        if (lcfg.shard_count > 1) {
+            cache_suffix = "_" + to_string(lcfg.shard_index) + "of" + to_string(lcfg.shard_count);
+        }
+
+        base_manifest = manifest;
+    } else {
+        // the manifest defines which data should be included in the dataset
+        auto manifest = make_shared<nervana::manifest_csv>(lcfg.manifest_filename,
+                                                           lcfg.shuffle_manifest);
+
+        // TODO: make the constructor throw this error
+        if(manifest->objectCount() == 0) {
+            throw std::runtime_error("manifest file is empty");
+        }
+
+        if(lcfg.sample_weights == "balanced") {
+            // records with the same label are in the same class.  Any other
+            // target would make each record a class of its own.
+            affirm(lcfg.type.size() > 6 && lcfg.type.compare(lcfg.type.size() - 6, 6, ",label") == 0,
+                   "sample_weights balanced needs a label target");
+            affirm(lcfg.subset_fraction == 1, "subset_fraction must be 1.0 with sample_weights");
+            auto label = _lcfg_json.find("label");
+            weights = block_iterator_sampled::balanced(
+                read_labels(*manifest, label == _lcfg_json.end() ? nlohmann::json() : *label));
+        } else if(lcfg.sample_weights == "column") {
+            // the last column weighs each record.  It isn't loaded, and the
+            // cache mustn't be taken for the one of the same manifest read
+            // without it.
+            affirm(lcfg.subset_fraction == 1, "subset_fraction must be 1.0 with sample_weights");
+            for(auto& w : manifest->take_last_column()) {
+                try {
+                    weights.push_back(stof(w));
+                } catch(std::exception&) {
+                    throw std::runtime_error("manifest weight is not a number: " + w);
+                }
+            }
+            cache_suffix = "_sampled";
+        }
+
+        // every shard reads the whole manifest but loads only its own blocks.
+        // Unless equal_shards is turned off, each drops the blocks that
+        // don't divide evenly so that all of them have the same itemCount.
+        _block_loader = make_shared<block_loader_file>(manifest,
+                                                       lcfg.subset_fraction,
+                                                       lcfg.macrobatch_size,
+                                                       lcfg.shard_count,
+                                                       lcfg.shard_index,
+                                                       lcfg.equal_shards);
+        affirm(_block_loader->shardBlockCount() > 0, "manifest has fewer blocks than shards");
+        base_manifest = manifest;
+    }
+
+    if(lcfg.cache_directory.length() > 0) {
+        // shards of a csv manifest share the cache, each filling in its own
+        // blocks.  nds numbers every shard's blocks from 0 so they can't.
+        string cache_id = base_manifest->cache_id() + to_string(_block_loader->objectCount()) + cache_suffix;
+        // blocks are written to the cache in the background unless
+        // cache_write_queue_mb is 0.  cache_max_bytes bounds every cache
+        // under cache_directory together, 0 is unlimited.
+        _block_loader = make_shared<block_loader_cpio_cache>(lcfg.cache_directory,
+                                                             cache_id,
+                                                             base_manifest->version(),
+                                                             _block_loader,
+                                                             (size_t) lcfg.cache_write_queue_mb << 20,
+                                                             lcfg.cache_max_bytes);
+    }
+
+    if(lcfg.read_prefetch_depth > 0) {
+        // read blocks with several threads ahead of the block iterator
+        _block_loader = make_shared<block_loader_async>(_block_loader,
+                                                        lcfg.read_thread_count,
+                                                        lcfg.read_prefetch_depth,
+                                                        _read_cpus);
+    }
+
+    shared_ptr<block_iterator> block_iter;
+    if (weights.size() > 0) {
+        // records are drawn one at a time, with replacement
+        block_iter = make_shared<block_iterator_sampled>(_block_loader, weights, lcfg.random_seed);
+    } else if (lcfg.shuffle_every_epoch) {
+        // records are shuffled across shuffle_window blocks at a time
+        block_iter = make_shared<block_iterator_shuffled>(_block_loader, lcfg.random_seed,
+                                                          lcfg.shuffle_window);
+    } else {
+        block_iter = make_shared<block_iterator_sequential>(_block_loader);
+    }
+
+    _batch_iterator = make_shared<batch_iterator>(block_iter, lcfg.minibatch_size);
+
+    if(lcfg.decoded_cache_directory.length() > 0) {
+        // every epoch would get the transforms drawn for the first
+        if(decoded_cache::randomized(_lcfg_json)) {
+            throw std::invalid_argument("decoded_cache_directory can't be used with random transforms");
+        }
+
+        // decoded records depend on the data, the media configuration and
+        // how records are numbered, but not on how the loader runs
+        nlohmann::json key = _lcfg_json;
+        for (auto name : {"minibatch_size", "cache_directory", "cache_write_queue_mb",
+                          "cache_max_bytes", "decoded_cache_directory", "shuffle_every_epoch",
+                          "single_thread", "read_thread_count", "read_prefetch_depth",
+                          "read_buffer_count", "decode_buffer_count", "decode_thread_count",
+                          "decode_thread_cpus", "read_thread_cpus", "manager_thread_cpus",
+                          "numa_node", "defer_transfer", "autotune", "autotune_batches", "equal_shards",
+                          "shuffle_window"}) {
+            key.erase(name);
+        }
+        _decoded_cache_directory = lcfg.decoded_cache_directory;
+        _decoded_cache_hash = hash_string(base_manifest->cache_id() + base_manifest->version() +
+                                          to_string(_block_loader->objectCount()) + key.dump());
+    }
+}
+
+int loader_core::start()
+{
+    _holding = false;
+    try {
+        // size the pool from the cpus the decode threads may actually use,
+        // which in a container is often far less than the host has
+        int ncores         = _decode_cpus.empty() ? cpu::available() : (int)_decode_cpus.size();
+        int itemsPerThread = (_batchSize - 1) /  ncores + 1;
+        int nthreads       = (_batchSize - 1) / itemsPerThread + 1;
+        if (_batchSize < ncores) {
+            // the threads left over by a small minibatch start on the next
+            nthreads = ncores;
+        }
+        if (_decode_thread_count > 0) {
+            nthreads = _decode_thread_count;
+        }
+        nthreads           = _single_thread_mode ? 1 : nthreads;
+
+        if (nthreads <= 0)
+        {
+            throw std::invalid_argument("Number of threads must be > 0");
+        }
+
+        // minibatches decoded at once, enough to keep every thread busy.
+        // Each needs a read and an output buffer, and the reader and the
+        // consumer need one more of each.
+        int depth = decode_depth(nthreads);
+        _read_buffer_count = std::max(_read_buffer_count, depth + 1);
+
+        // the autotuner starts from the configuration and may use up to a
+        // thread per core and a few more read buffers.  The rings are sized
+        // for the depth the most threads need.
+        int poolThreads = nthreads;
+        int readBuffers = _read_buffer_count;
+        _autotuner = nullptr;
+        if (_autotune) {
+            poolThreads = std::max(nthreads, ncores);
+            readBuffers = std::max(_read_buffer_count, 8);
+            _autotuner.reset(new autotuner(nthreads, poolThreads, _read_buffer_count, readBuffers,
+                                           _autotune_batches));
+            _window_batches = -1;
+        }
+        int maxDepth = decode_depth(poolThreads);
+        readBuffers = std::max(readBuffers, maxDepth + 1);
+        _decode_buffer_count = std::max(_decode_buffer_count, maxDepth + 1);
+
+        vector<shared_ptr<nervana::provider_interface>> providers;
+        for (int i=0; i<poolThreads; i++) {
+            providers.push_back(nervana::provider_factory::create(_lcfg_json));
+        }
+
+        // variable size buffers for reading encoded data (start off zero and grow as needed)
+        _read_buffers = make_shared<buffer_pool_in>(providers[0]->num_inputs, readBuffers);
+        _read_buffers->set_depth(_read_buffer_count);
+        _read_thread_pool = unique_ptr<read_thread_pool>(
+                        new read_thread_pool(_read_buffers, _batch_iterator));
+        _read_thread_pool->set_cpus(_read_cpus);
+        // every minibatch not yet taken by the consumer is in one of the
+        // buffers, so these are all get_state can ask for
+        _read_thread_pool->keep_states(readBuffers + _decode_buffer_count);
+
+        // fixed size buffers for writing out decoded data
+        _oshapes = providers[0]->get_oshapes();
+        vector<size_t> write_sizes;
+        for (auto& o: _oshapes)
+        {
+            write_sizes.push_back(o.get_byte_size());
+        }
+
+        if (_decoded_cache == nullptr && _decoded_cache_hash.length() > 0) {
+            size_t records = (size_t)_block_loader->blockCount() * _block_loader->blockSize();
+            _decoded_cache = make_shared<decoded_cache>(_decoded_cache_directory,
+                                                        _decoded_cache_hash,
+                                                        records,
+                                                        write_sizes);
+        }
+
+        _backend = make_backend(_oshapes);
+        bool pinned = _backend && _backend->use_pinned_memory();
+        // These are fixed size output buffers (need batchSize for stride)
+        auto make_decode_buffers = [&]() {
+            _decode_buffers = make_shared<buffer_pool_out>(write_sizes,
+                                                           (size_t)_batchSize,
+                                                           pinned,
+                                                           _decode_buffer_count);
+        };
+        if (_node_cpus.empty() || pinned) {
+            make_decode_buffers();
+        } else {
+            // allocate and first touch the output buffers from the NUMA node
+            // that fills them so the kernel places their pages there.
+            // Pinned memory is left alone, it belongs to the device context.
+            exception_ptr error;
+            thread toucher([&]() {
+                try {
+                    cpu::pin(_node_cpus);
+                    make_decode_buffers();
+                    for (int i = 0; i < _decode_buffer_count; i++) {
+                        buffer_out_array& buffers = _decode_buffers->get(i);
+                        for (size_t j = 0; j < buffers.size(); j++) {
+                            memset(buffers[j]->data(), 0, buffers[j]->size());
+                        }
+                    }
+                } catch (...) {
+                    error = current_exception();
+                }
+            });
+            toucher.join();
+            if (error) {
+                rethrow_exception(error);
+            }
+        }
+
+        _decode_thread_pool = unique_ptr<decode_thread_pool>(
+                new decode_thread_pool(poolThreads, _read_buffers, _decode_buffers,
+                                       _defer_transfer ? nullptr : _backend,
+                                       _decoded_cache));
+        _decode_thread_pool->set_active_threads(nthreads);
+        _decode_thread_pool->set_depth(depth);
+        _decode_thread_pool->set_cpus(_decode_cpus);
+        _decode_thread_pool->set_manager_cpus(_manager_cpus);
+
+        for (auto& p: providers)
+        {
+            _decode_thread_pool->add_provider(p);
+        }
+
+    } catch(std::bad_alloc&) {
+        return -1;
+    }
+    _decode_thread_pool->start();
+    _read_thread_pool->start();
+
+    return 0;
+}
+
+void loader_core::stop()
+{
+    _read_thread_pool->stop();
+    while (_read_thread_pool->stopped() == false)
+    {
+        std::this_thread::yield();
+        drain();
+    }
+    while ((_decode_buffers->empty() == false) ||
+           (_read_buffers->empty() == false))
+    {
+        drain();
+    }
+    _decode_thread_pool->stop();
+
+    _read_thread_pool   = nullptr;
+    _decode_buffers     = nullptr;
+    _decode_thread_pool = nullptr;
+    _backend            = nullptr;
+    _holding            = false;
+    _consumed           = 0;
+    _discard_until      = 0;
+}
+
+int loader_core::reset()
+{
+    if (_read_thread_pool == nullptr) {
+        _batch_iterator->reset();
+        return 0;
+    }
+    release();
+    restart(nullptr);
+    return 0;
+}
+
+const char* loader_core::get_state()
+{
+    nlohmann::json state;
+    if (_read_thread_pool == nullptr) {
+        state = _batch_iterator->get_state();
+    } else {
+        // a minibatch still held has been seen, the one after it is next
+        uint64_t n = max(_consumed + (_holding ? 1 : 0), _discard_until);
+        state = _read_thread_pool->state(n);
+    }
+    _state = state.dump();
+    return _state.c_str();
+}
+
+int loader_core::set_state(const string& state)
+{
+    nlohmann::json js = nlohmann::json::parse(state);
+    if (_read_thread_pool == nullptr) {
+        _batch_iterator->set_state(js);
+        return 0;
+    }
+    release();
+    restart(js);
+    return 0;
+}
+
+void loader_core::restart(const nlohmann::json& state)
+{
+    // minibatches read before the restart are still on their way.  next()
+    // throws them away and they needn't be decoded.
+    _discard_until = _read_thread_pool->restart(state);
+    _decode_thread_pool->skip_until(_discard_until);
+}
+
+int loader_core::next(vector<const buffer_out*>& outputs)
+{
+    affirm(_holding == false, "release the previous minibatch before calling next");
+
+    uint64_t waiting = stats::now();
+    do {
+        _decode_buffers->wait_for_not_empty();
+    } while (discard());
+    if (_autotuner) {
+        autotune(stats::now() - waiting);
+    }
+    _decode_buffers->reraise_exception();
+
+    int index = _decode_buffers->read_pos();
+    buffer_out_array& buffers = _decode_buffers->get(index);
+    if (_defer_transfer && _backend) {
+        // ctypes releases the GIL for the call into next(), so a python
+        // backend still takes it back here.  It does so on the consumer's
+        // thread while the consumer waits on next() anyway, instead of
+        // from the finisher while the consumer is running python.
+        stats::timer timer(stats::stage::backend_transfer);
+        _backend->call_backend_transfer(buffers, index);
+    }
+    outputs.clear();
+    for (size_t i = 0; i < buffers.size(); i++) {
+        outputs.push_back(buffers[i]);
+    }
+    _holding = true;
+    return index;
+}
+
+void loader_core::release()
+{
+    if (_holding == false) {
+        return;
+    }
+    _holding = false;
+    _consumed++;
+    _decode_buffers->advance_read_pos();
+    _decode_buffers->signal_not_full();
+}
+
+bool loader_core::discard()
+{
+    // Throws away the next minibatch if it was read before the last
+    // restart.  Minibatches are numbered in the order they were read all
+    // along the pipeline, so those are the ones before _discard_until.
+    if (_consumed >= _discard_until) {
+        return false;
+    }
+    _consumed++;
+    _decode_buffers->advance_read_pos();
+    _decode_buffers->signal_not_full();
+    return true;
+}
+
+void loader_core::autotune(uint64_t waited)
+{
+    // the autotuner looks at windows of 8 minibatches
+    uint64_t now = stats::now();
+    if (_window_batches >= 0) {
+        _window_wait += waited;
+        if (++_window_batches < 8) {
+            return;
+        }
+        bool tuning = _autotuner->update(now - _window_start, _window_wait,
+                                         _decode_thread_pool->input_wait_ns() - _window_input_wait,
+                                         _window_batches);
+        // more threads may need more minibatches decoded at once, and a
+        // read buffer more than that
+        int depth = decode_depth(_autotuner->threads());
+        int readDepth = std::max(_autotuner->depth(), depth + 1);
+        _decode_thread_pool->set_active_threads(_autotuner->threads());
+        _decode_thread_pool->set_depth(depth);
+        _read_buffers->set_depth(readDepth);
+        if (!tuning) {
+            // later starts use the tuned values as if they had been configured
+            INFO << "autotune chose decode_thread_count " << _autotuner->threads()
+                 << " and read_buffer_count " << readDepth;
+            _decode_thread_count = _autotuner->threads();
+            _read_buffer_count = readDepth;
+            _autotune = false;
+            _autotuner = nullptr;
+            return;
+        }
+    }
+    _window_batches = 0;
+    _window_start = now;
+    _window_wait = 0;
+    _window_input_wait = _decode_thread_pool->input_wait_ns();
+}
+
+int loader_core::decode_depth(int threads) const
+{
+    return (threads - 1) / _batchSize + 1;
+}
+
+const char* loader_core::stats()
+{
+    nlohmann::json js;
+    js["stages"] = stats::snapshot();
+    if (_read_buffers) {
+        js["read_buffers"] = {{"used", _read_buffers->used()}, {"count", _read_buffers->depth()}};
+    }
+    if (_decode_thread_pool) {
+        js["decode_threads"] = _decode_thread_pool->active_threads();
+    }
+    if (_decode_buffers) {
+        js["decode_buffers"] = {{"used", _decode_buffers->used()}, {"count", _decode_buffers->count()}};
+    }
+    _stats = js.dump();
+    return _stats.c_str();
+}
+
+void loader_core::drain()
+{
+    if (_decode_buffers->empty() == true) {
+        return;
+    }
+    _decode_buffers->advance_read_pos();
+    _decode_buffers->signal_not_full();
+}
@@ -0,0 +1,411 @@
+/*
+ Copyright 2016 Nervana Systems Inc.
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#pragma once
+
+#include <vector>
+#include <cstdio>
+#include <iostream>
+#include <chrono>
+#include <utility>
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <mutex>
+
+#include "backend.hpp"
+#include "thread_pool.hpp"
+#include "block_loader.hpp"
+#include "block_iterator.hpp"
+#include "batch_iterator.hpp"
+#include "manifest.hpp"
+#include "provider_factory.hpp"
+#include "buffer_pool_in.hpp"
+#include "buffer_pool_out.hpp"
+#include "decoded_cache.hpp"
+#include "autotune.hpp"
+#include "event_count.hpp"
+#include "spsc_queue.hpp"
+
+namespace nervana {
+    class decode_thread_pool;
+    class loader_config;
+    class read_thread_pool;
+    class loader_core;
+}
+
+/* decode_thread_pool
+ *
+ * decode_thread_pool takes data from the BufferPool `in`, transforms it
+ * using `count` threads with a Media::transform built from
+ * `mediaParams`.  A manager thread hands minibatches to the workers, up to
+ * `depth` of them at once, and the workers claim records one at a time from
+ * a shared counter that runs on from one minibatch into the next.  A slow
+ * record only holds up the thread decoding it, and with more threads than
+ * records in a minibatch the spare threads start on the following ones.
+ * Decoded minibatches are post processed and handed to the backend, if any,
+ * by a finisher thread in the order they were handed out.  With a
+ * decoded_cache, records it already holds are copied instead of decoded.
+ *
+ */
+class nervana::decode_thread_pool : public nervana::thread_pool {
+public:
+    decode_thread_pool(int count,
+                       const std::shared_ptr<nervana::buffer_pool_in>& in,
+                       const std::shared_ptr<nervana::buffer_pool_out>& out,
+                       const std::shared_ptr<nervana::backend>& be,
+                       const std::shared_ptr<nervana::decoded_cache>& decoded = nullptr);
+
+    virtual ~decode_thread_pool();
+    virtual void start() override;
+    virtual void stop() override;
+    void add_provider(std::shared_ptr<nervana::provider_interface> prov);
+
+    // restrict the manager and finisher threads to cpus, before start
+    void set_manager_cpus(const std::vector<int>& cpus) { _managerCpus = cpus; }
+
+    // decode up to depth minibatches at once, from the next one on.  Both
+    // buffer pools need a buffer more than that, for the reader and the
+    // consumer.
+    void set_depth(int depth);
+
+    // decode with only the first `count` threads from the next record on
+    void set_active_threads(int count);
+    int active_threads() const { return _active; }
+
+    // total time the manager has waited for read buffers, in ns
+    uint64_t input_wait_ns() const { return _inputWaitNs; }
+
+    // minibatches before the nth are going to be thrown away, so their
+    // records need not be decoded, post processed or transferred
+    void skip_until(uint64_t n);
+
+protected:
+    virtual void run(int id) override;
+    virtual void work(int id) override;
+    void produce();
+    void consume();
+    void manage();
+    void finish();
+
+private:
+    decode_thread_pool();
+    decode_thread_pool(const decode_thread_pool&);
+
+    // a minibatch handed to the workers.  The first worker to fail keeps
+    // its exception in error, and the finisher hands it to the output pool.
+    struct job {
+        nervana::buffer_in_array*   input       = 0;
+        nervana::buffer_out_array*  output      = 0;
+        int                         outputIndex = 0;
+        bool                        skip        = false;
+        std::atomic<int>            remaining{0};
+        std::atomic<bool>           failed{false};
+        std::exception_ptr          error;
+    };
+
+    std::shared_ptr<nervana::buffer_pool_in> _in;
+    std::shared_ptr<nervana::buffer_pool_out> _out;
+    std::shared_ptr<nervana::backend> _backend;
+    std::shared_ptr<nervana::decoded_cache> _decoded_cache;
+    int                         _batchSize;
+
+    // job n lives in _jobs[n % _jobs.size()], one slot per output buffer.
+    // The manager hands out job n by moving _dispatched past it.  The
+    // finisher gives back its read buffer once it is decoded by moving
+    // _released past it, and the slot once it is finished by moving
+    // _retired past it.  Record r of the stream belongs to job r / _batchSize.
+    std::vector<job>            _jobs;
+    std::atomic<int>            _depth{1};
+    std::atomic<uint64_t>       _dispatched{0};
+    std::atomic<uint64_t>       _released{0};
+    std::atomic<uint64_t>       _retired{0};
+    std::atomic<uint64_t>       _nextItem{0};
+    int                         _inputIndex     = 0;
+    event_count                 _started;
+    event_count                 _ended;
+    std::thread*                _manager        = 0;
+    std::atomic<bool>           _stopManager{false};
+    std::atomic<bool>           _managerStopped{false};
+    std::vector<int>            _managerCpus;
+    std::atomic<int>            _active;
+    std::atomic<uint64_t>       _inputWaitNs{0};
+    std::atomic<uint64_t>       _skipUntil{0};
+
+    // jobs waiting for post_process and the backend transfer
+    std::thread*                _finisher       = 0;
+    event_count                 _finishReady;
+    spsc_queue<int>             _finishQueue;
+    std::atomic<bool>           _stopFinisher{false};
+
+    std::vector<std::shared_ptr<nervana::provider_interface>> _providers;
+};
+
+class nervana::loader_config : public nervana::interface::config {
+public:
+    std::string manifest_filename;
+    int         minibatch_size;
+
+    std::string type;
+    std::string cache_directory     = "";
+    int         cache_write_queue_mb = 256;
+    size_t      cache_max_bytes     = 0;
+    std::string decoded_cache_directory = "";
+    int         macrobatch_size     = 0;
+    float       subset_fraction     = 1.0;
+    bool        shuffle_every_epoch = false;
+    bool        shuffle_manifest    = false;
+    int         shuffle_window      = 1;
+    std::string sample_weights      = "";
+    bool        single_thread       = false;
+    int         random_seed         = 0;
+    int         shard_count         = 1;
+    int         shard_index         = 0;
+    bool        equal_shards        = true;
+    int         read_thread_count   = 1;
+    int         read_prefetch_depth = 0;
+    int         read_buffer_count   = 2;
+    int         decode_buffer_count = 2;
+    int         decode_thread_count = 0;
+    std::string decode_thread_cpus  = "";
+    std::string read_thread_cpus    = "";
+    std::string manager_thread_cpus = "";
+    int         numa_node           = -1;
+    bool        defer_transfer      = false;
+    bool        autotune            = false;
+    int         autotune_batches    = 64;
+
+    loader_config(nlohmann::json js)
+    {
+        if(js.is_null()) {
+            throw std::runtime_error("missing loader config in json config");
+        }
+
+        for(auto& info : config_list) {
+            info->parse(js);
+        }
+        verify_config("loader", config_list, js);
+
+        if(macrobatch_size == 0) {
+            macrobatch_size = minibatch_size;
+        }
+
+        if(shard_index >= shard_count) {
+            throw std::invalid_argument("shard_index must be less than shard_count");
+        }
+
+        // extra reader threads are only useful with blocks to work on
+        if(read_thread_count > 1 && read_prefetch_depth == 0) {
+            read_prefetch_depth = read_thread_count;
+        }
+
+        validate();
+    }
+
+private:
+    std::vector<std::shared_ptr<nervana::interface::config_info_interface>> config_list = {
+        ADD_SCALAR(type, mode::REQUIRED),
+        ADD_SCALAR(manifest_filename, mode::REQUIRED),
+        ADD_SCALAR(minibatch_size, mode::REQUIRED),
+        ADD_SCALAR(cache_directory, mode::OPTIONAL),
+        ADD_SCALAR(cache_write_queue_mb, mode::OPTIONAL, [](int v){ return v >= 0; }),
+        ADD_SCALAR(cache_max_bytes, mode::OPTIONAL),
+        ADD_SCALAR(decoded_cache_directory, mode::OPTIONAL),
+        ADD_SCALAR(macrobatch_size, mode::OPTIONAL),
+        ADD_SCALAR(subset_fraction, mode::OPTIONAL),
+        ADD_SCALAR(shuffle_every_epoch, mode::OPTIONAL),
+        ADD_SCALAR(shuffle_manifest, mode::OPTIONAL),
+        ADD_SCALAR(shuffle_window, mode::OPTIONAL, [](int v){ return v > 0; }),
+        ADD_SCALAR(sample_weights, mode::OPTIONAL, [](const std::string& v){
+            return v == "" || v == "column" || v == "balanced";
+        }),
+        ADD_SCALAR(single_thread, mode::OPTIONAL),
+        ADD_SCALAR(random_seed, mode::OPTIONAL),
+        ADD_SCALAR(shard_count, mode::OPTIONAL, [](int v){ return v > 0; }),
+        ADD_SCALAR(shard_index, mode::OPTIONAL, [](int v){ return v >= 0; }),
+        ADD_SCALAR(equal_shards, mode::OPTIONAL),
+        ADD_SCALAR(read_thread_count, mode::OPTIONAL, [](int v){ return v > 0; }),
+        ADD_SCALAR(read_prefetch_depth, mode::OPTIONAL, [](int v){ return v >= 0; }),
+        ADD_SCALAR(read_buffer_count, mode::OPTIONAL, [](int v){ return v >= 2; }),
+        ADD_SCALAR(decode_buffer_count, mode::OPTIONAL, [](int v){ return v >= 2; }),
+        ADD_SCALAR(decode_thread_count, mode::OPTIONAL, [](int v){ return v >= 0; }),
+        ADD_SCALAR(decode_thread_cpus, mode::OPTIONAL),
+        ADD_SCALAR(read_thread_cpus, mode::OPTIONAL),
+        ADD_SCALAR(manager_thread_cpus, mode::OPTIONAL),
+        ADD_SCALAR(numa_node, mode::OPTIONAL, [](int v){ return v >= -1; }),
+        ADD_SCALAR(defer_transfer, mode::OPTIONAL),
+        ADD_SCALAR(autotune, mode::OPTIONAL),
+        ADD_SCALAR(autotune_batches, mode::OPTIONAL, [](int v){ return v > 0; }),
+    };
+
+    loader_config() {}
+    bool validate() { return true; }
+};
+
+/*
+ * The read_thread_pool wraps BatchIterator in a thread an coordinates work
+ * with other threads via locks on the output BufferPool `out`
+ *
+ * restart() moves BatchIterator between two of the reader's minibatches,
+ * back to the start of the next epoch or to a state, without stopping the
+ * thread.  The minibatches read before that are still in the buffers, and
+ * restart() returns how many there were so the consumer can throw them away.
+ * The iterator's state before each of the last few minibatches is kept for
+ * state().
+ */
+
+class nervana::read_thread_pool: public thread_pool {
+public:
+    read_thread_pool(const std::shared_ptr<nervana::buffer_pool_in>& out,
+                     const std::shared_ptr<nervana::batch_iterator>& batch_iterator);
+
+    // resets the iterator, or moves it to state if that isn't null, and
+    // returns the number of minibatches read before
+    uint64_t restart(const nlohmann::json& state = nullptr);
+
+    // the iterator's state before minibatch n was read.  The states of the
+    // last `count` minibatches and of the next one are kept.
+    nlohmann::json state(uint64_t n);
+    void keep_states(size_t count) { _keep = count; }
+
+protected:
+    virtual void work(int id) override;
+
+private:
+    read_thread_pool();
+    read_thread_pool(const read_thread_pool&);
+    std::shared_ptr<nervana::buffer_pool_in> _out;
+    std::shared_ptr<nervana::batch_iterator> _batch_iterator;
+
+    // held while the iterator is in use.  _states.back() is the state of
+    // minibatch _batchesRead, the next to be read.
+    std::mutex                               _mutex;
+    uint64_t                                 _batchesRead = 0;
+    std::deque<nlohmann::json>               _states;
+    size_t                                   _keep = 0;
+};
+
+
+/* loader_core
+ *
+ * The loader_core instantiates and then coordinates the effort of loading ingested data, caching
+ * blocks of it in contiguous disk (using cpio file format) and transforming the data into
+ * minibatches.  It has no dependency on Python: a C++ consumer takes each minibatch with next()
+ * and hands its buffers back with release().  A backend, from make_backend(), is given every
+ * minibatch as soon as it is finished, or with defer_transfer on the consumer's thread inside
+ * next(), before next() returns it.
+*/
+
+class nervana::loader_core {
+public:
+    loader_core(const std::string& config);
+
+    virtual ~loader_core() {}
+    int start();
+    virtual void stop();
+
+    // starts the next epoch.  The threads, providers and backend carry on:
+    // the reader starts over at once and next() throws away the minibatches
+    // that were already on their way.
+    int reset();
+
+    // the position of the minibatch next() returns next, as json, and a move
+    // straight to one in the same way as reset.  Only the block the position
+    // is in is read again.  The string stays valid until the next call.
+    const char* get_state();
+    int set_state(const std::string& state);
+
+    // waits for the next minibatch and points outputs at its buffers, one
+    // per output shape.  They stay valid until release(), which must come
+    // before the following call.  Returns the buffer's index in the ring.
+    int next(std::vector<const nervana::buffer_out*>& outputs);
+    void release();
+
+    // shapes of the outputs, valid once started
+    const std::vector<nervana::shape_type>& oshapes() const { return _oshapes; }
+    int batch_size() const { return _batchSize; }
+    int buffer_count() const { return _decode_buffer_count; }
+
+    // stage latencies and buffer occupancy as a json object.  The string
+    // stays valid until the next call.
+    const char* stats();
+
+    // records in this loader's shard, which is all of them unless sharded
+    int itemCount() { return _block_loader->shardObjectCount(); }
+
+protected:
+    // called from start() once the output shapes are known and before the
+    // output buffers are allocated.  Without a backend minibatches go
+    // straight to next().
+    virtual std::shared_ptr<nervana::backend> make_backend(const std::vector<nervana::shape_type>& oshapes)
+    {
+        return nullptr;
+    }
+
+private:
+    void drain();
+    void restart(const nlohmann::json& state);
+    bool discard();
+    void autotune(uint64_t waited);
+    int decode_depth(int threads) const;
+
+private:
+    loader_core();
+    loader_core(const loader_core&);
+
+    bool                                        _holding = false;
+    bool                                        _single_thread_mode = false;
+    bool                                        _defer_transfer = false;
+
+    // minibatches taken off the output buffers since start, and how many
+    // were read before the last restart.  next() throws away the ones
+    // between the two.
+    uint64_t                                    _consumed = 0;
+    uint64_t                                    _discard_until = 0;
+
+    std::shared_ptr<nervana::buffer_pool_in>    _read_buffers = nullptr;
+    std::shared_ptr<nervana::buffer_pool_out>   _decode_buffers = nullptr;
+    std::unique_ptr<nervana::read_thread_pool>  _read_thread_pool = nullptr;
+    std::unique_ptr<decode_thread_pool>         _decode_thread_pool = nullptr;
+    std::shared_ptr<nervana::block_loader>      _block_loader = nullptr;
+    std::shared_ptr<nervana::batch_iterator>    _batch_iterator = nullptr;
+    std::shared_ptr<nervana::decoded_cache>     _decoded_cache = nullptr;
+    std::shared_ptr<nervana::backend>           _backend = nullptr;
+    std::unique_ptr<nervana::autotuner>         _autotuner = nullptr;
+    std::string                                 _decoded_cache_directory;
+    std::string                                 _decoded_cache_hash;
+
+    int                                         _batchSize;
+    int                                         _read_buffer_count;
+    int                                         _decode_buffer_count;
+    int                                         _decode_thread_count;
+    std::vector<int>                            _decode_cpus;
+    std::vector<int>                            _read_cpus;
+    std::vector<int>                            _manager_cpus;
+    std::vector<int>                            _node_cpus;
+    std::vector<nervana::shape_type>            _oshapes;
+
+    // the window of minibatches the autotuner is measuring, which starts
+    // after the first minibatch so filling the pipeline doesn't count
+    bool                                        _autotune = false;
+    int                                         _autotune_batches;
+    int                                         _window_batches = -1;
+    uint64_t                                    _window_start = 0;
+    uint64_t                                    _window_wait = 0;
+    uint64_t                                    _window_input_wait = 0;
+    std::string                                 _stats;
+    std::string                                 _state;
+    nlohmann::json                              _lcfg_json;
+};
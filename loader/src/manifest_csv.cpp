@@ -44,10 +44,7 @@ manifest_csv::manifest_csv(string filename, bool shuffle)
 string manifest_csv::cache_id()
 {
     // returns a hash of the _filename
-    std::size_t h = std::hash<std::string>()(_filename);
-    stringstream ss;
-    ss << std::hex << h;
-    return ss.str();
+    return hash_string(_filename);
 }
 
 string manifest_csv::version()
@@ -110,6 +107,18 @@ void manifest_csv::parse_stream(istream& is)
     }
 }
 
+vector<string> manifest_csv::take_last_column()
+{
+    vector<string> column;
+    column.reserve(_filename_lists.size());
+    for (auto& file_list : _filename_lists) {
+        affirm(file_list.size() > 1, "manifest has no column to spare");
+        column.push_back(file_list.back());
+        file_list.pop_back();
+    }
+    return column;
+}
+
 void manifest_csv::shuffle_filename_lists()
 {
     // shuffles _filename_lists.  It is possible that the order of the
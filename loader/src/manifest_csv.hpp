@@ -49,6 +49,10 @@ namespace nervana {
         std::string version();
         size_t objectCount() const { return _filename_lists.size(); }
 
+        // removes the last field of every line and returns them in order,
+        // for a column that isn't a file to load
+        std::vector<std::string> take_last_column();
+
         // begin and end provide iterators over the FilenameLists
         iter begin() const { return _filename_lists.begin(); }
         iter end() const { return _filename_lists.end(); }
@@ -19,6 +19,7 @@
 #include "json.hpp"
 #include "manifest_nds.hpp"
 #include "interface.hpp"
+#include "util.hpp"
 
 using namespace std;
 using namespace nervana;
@@ -60,10 +61,7 @@ manifest_nds::manifest_nds(const std::string filename) {
 string manifest_nds::cache_id() {
     stringstream contents;
     contents << baseurl << collection_id;
-    std::size_t h = std::hash<std::string>()(contents.str());
-    stringstream ss;
-    ss << std::hex << h;
-    return ss.str();
+    return hash_string(contents.str());
 }
 
 bool manifest_nds::is_likely_json(const std::string filename) {
@@ -35,16 +35,21 @@ audio_classifier::audio_classifier(nlohmann::json js) :
 
 void audio_classifier::provide(int idx, buffer_in_array& in_buf, buffer_out_array& out_buf)
 {
-    vector<char>& datum_in  = in_buf[0]->get_item(idx);
-    vector<char>& target_in = in_buf[1]->get_item(idx);
+    span datum_in  = in_buf[0]->get_item(idx);
+    span target_in = in_buf[1]->get_item(idx);
 
     char* datum_out  = out_buf[0]->get_item(idx);
     char* target_out = out_buf[1]->get_item(idx);
 
     // Process audio data
+    stats::split split;
     auto audio_dec = audio_extractor.extract(datum_in.data(), datum_in.size());
+    split.mark(stats::stage::extract);
     auto audio_params = audio_factory.make_params(audio_dec);
-    audio_loader.load({datum_out}, audio_transformer.transform(audio_params, audio_dec));
+    auto audio_transformed = audio_transformer.transform(audio_params, audio_dec);
+    split.mark(stats::stage::transform);
+    audio_loader.load({datum_out}, audio_transformed);
+    split.mark(stats::stage::load);
 
     // Process target data
     auto label_dec = label_extractor.extract(target_in.data(), target_in.size());
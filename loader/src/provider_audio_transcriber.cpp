@@ -41,8 +41,8 @@ audio_transcriber::audio_transcriber(nlohmann::json js) :
 
 void audio_transcriber::provide(int idx, buffer_in_array& in_buf, buffer_out_array& out_buf)
 {
-    vector<char>& datum_in  = in_buf[0]->get_item(idx);
-    vector<char>& target_in = in_buf[1]->get_item(idx);
+    span datum_in  = in_buf[0]->get_item(idx);
+    span target_in = in_buf[1]->get_item(idx);
 
     char* datum_out  = out_buf[0]->get_item(idx);
     char* target_out = out_buf[1]->get_item(idx);
@@ -50,9 +50,14 @@ void audio_transcriber::provide(int idx, buffer_in_array& in_buf, buffer_out_arr
     char* valid_out  = out_buf[3]->get_item(idx);
 
     // Process audio data
+    stats::split split;
     auto audio_dec = audio_extractor.extract(datum_in.data(), datum_in.size());
+    split.mark(stats::stage::extract);
     auto audio_params = audio_factory.make_params(audio_dec);
-    audio_loader.load({datum_out}, audio_transformer.transform(audio_params, audio_dec));
+    auto audio_transformed = audio_transformer.transform(audio_params, audio_dec);
+    split.mark(stats::stage::transform);
+    audio_loader.load({datum_out}, audio_transformed);
+    split.mark(stats::stage::load);
 
     // Process target data
     auto trans_dec = trans_extractor.extract(target_in.data(), target_in.size());
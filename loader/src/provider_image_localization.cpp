@@ -36,8 +36,8 @@ image_localization::image_localization(nlohmann::json js) :
 }
 
 void image_localization::provide(int idx, buffer_in_array& in_buf, buffer_out_array& out_buf) {
-    vector<char>& datum_in  = in_buf[0]->get_item(idx);
-    vector<char>& target_in = in_buf[1]->get_item(idx);
+    span datum_in  = in_buf[0]->get_item(idx);
+    span target_in = in_buf[1]->get_item(idx);
 
     char* datum_out             = out_buf[0]->get_item(idx);
     char* y_bbtargets_out       = out_buf[1]->get_item(idx);
@@ -68,10 +68,15 @@ void image_localization::provide(int idx, buffer_in_array& in_buf, buffer_out_ar
         throw std::runtime_error(ss.str());
     }
 
+    stats::split split;
     auto image_dec = image_extractor.extract(datum_in.data(), datum_in.size());
+    split.mark(stats::stage::extract);
     if(image_dec) {
         auto image_params = image_factory.make_params(image_dec);
-        image_loader.load({datum_out}, image_transformer.transform(image_params, image_dec));
+        auto image_transformed = image_transformer.transform(image_params, image_dec);
+        split.mark(stats::stage::transform);
+        image_loader.load({datum_out}, image_transformed);
+        split.mark(stats::stage::load);
 
         // Process target data
         auto target_dec = localization_extractor.extract(target_in.data(), target_in.size());
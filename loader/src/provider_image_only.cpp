@@ -30,7 +30,7 @@ image_only::image_only(nlohmann::json js) :
 }
 
 void image_only::provide(int idx, buffer_in_array& in_buf, buffer_out_array& out_buf) {
-    std::vector<char>& datum_in  = in_buf[0]->get_item(idx);
+    span datum_in  = in_buf[0]->get_item(idx);
     char* datum_out  = out_buf[0]->get_item(idx);
 
     if (datum_in.size() == 0) {
@@ -40,7 +40,12 @@ void image_only::provide(int idx, buffer_in_array& in_buf, buffer_out_array& out
     }
 
     // Process image data
+    stats::split split;
     auto image_dec = image_extractor.extract(datum_in.data(), datum_in.size());
+    split.mark(stats::stage::extract);
     auto image_params = image_factory.make_params(image_dec);
-    image_loader.load({datum_out}, image_transformer.transform(image_params, image_dec));
+    auto image_transformed = image_transformer.transform(image_params, image_dec);
+    split.mark(stats::stage::transform);
+    image_loader.load({datum_out}, image_transformed);
+    split.mark(stats::stage::load);
 }
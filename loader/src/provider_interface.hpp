@@ -20,6 +20,7 @@
 #include "interface.hpp"
 #include "buffer_in.hpp"
 #include "buffer_out.hpp"
+#include "stats.hpp"
 
 namespace nervana {
     class provider_interface;
@@ -35,8 +35,8 @@ video_classifier::video_classifier(nlohmann::json js) :
 
 void video_classifier::provide(int idx, buffer_in_array& in_buf, buffer_out_array& out_buf)
 {
-    std::vector<char>& datum_in  = in_buf[0]->get_item(idx);
-    std::vector<char>& target_in = in_buf[1]->get_item(idx);
+    span datum_in  = in_buf[0]->get_item(idx);
+    span target_in = in_buf[1]->get_item(idx);
     char* datum_out  = out_buf[0]->get_item(idx);
     char* target_out = out_buf[1]->get_item(idx);
 
@@ -45,9 +45,14 @@ void video_classifier::provide(int idx, buffer_in_array& in_buf, buffer_out_arra
     }
 
     // Process video data
+    stats::split split;
     auto video_dec = video_extractor.extract(datum_in.data(), datum_in.size());
+    split.mark(stats::stage::extract);
     auto frame_params = frame_factory.make_params(video_dec);
-    video_loader.load({datum_out}, video_transformer.transform(frame_params, video_dec));
+    auto video_transformed = video_transformer.transform(frame_params, video_dec);
+    split.mark(stats::stage::transform);
+    video_loader.load({datum_out}, video_transformed);
+    split.mark(stats::stage::load);
 
     // Process target data
     auto label_dec = label_extractor.extract(target_in.data(), target_in.size());
@@ -31,7 +31,7 @@ video_only::video_only(nlohmann::json js) :
 
 void video_only::provide(int idx, buffer_in_array& in_buf, buffer_out_array& out_buf)
 {
-    std::vector<char>& datum_in  = in_buf[0]->get_item(idx);
+    span datum_in  = in_buf[0]->get_item(idx);
     char* datum_out  = out_buf[0]->get_item(idx);
 
     if (datum_in.size() == 0) {
@@ -41,7 +41,12 @@ void video_only::provide(int idx, buffer_in_array& in_buf, buffer_out_array& out
     }
 
     // Process video data
+    stats::split split;
     auto video_dec = video_extractor.extract(datum_in.data(), datum_in.size());
+    split.mark(stats::stage::extract);
     auto frame_params = frame_factory.make_params(video_dec);
-    video_loader.load({datum_out}, video_transformer.transform(frame_params, video_dec));
+    auto video_transformed = video_transformer.transform(frame_params, video_dec);
+    split.mark(stats::stage::transform);
+    video_loader.load({datum_out}, video_transformed);
+    split.mark(stats::stage::load);
 }
@@ -22,30 +22,68 @@ using namespace std;
 
 python_backend::python_backend(PyObject* py_obj_backend,
                                    const vector<nervana::shape_type>& oshape_types,
-                                   int batchSize)
-: _oshape_types(oshape_types), _batchSize(batchSize), _py_obj_backend(py_obj_backend)
+                                   int batchSize,
+                                   int bufferCount)
+: _oshape_types(oshape_types), _batchSize(batchSize), _bufferCount(bufferCount),
+  _py_obj_backend(py_obj_backend)
 {
     if (_py_obj_backend == NULL) {
         throw std::runtime_error("Python Backend object does not exist");
     }
 
-    Py_INCREF(_py_obj_backend);
-    _f_consume = PyObject_GetAttrString(_py_obj_backend, "consume");
+    PyGILState_STATE gstate;
+    gstate = PyGILState_Ensure();
 
-    if (!PyCallable_Check(_f_consume)) {
-        throw std::runtime_error("Backend 'consume' function does not exist or is not callable");
+    Py_INCREF(_py_obj_backend);
+    _f_consume_batch = PyObject_GetAttrString(_py_obj_backend, "consume_batch");
+    if (_f_consume_batch == NULL || !PyCallable_Check(_f_consume_batch)) {
+        PyErr_Clear();
+        Py_XDECREF(_f_consume_batch);
+        _f_consume_batch = NULL;
+
+        _f_consume = PyObject_GetAttrString(_py_obj_backend, "consume");
+        if (_f_consume == NULL || !PyCallable_Check(_f_consume)) {
+            PyErr_Clear();
+            Py_DECREF(_py_obj_backend);
+            PyGILState_Release(gstate);
+            throw std::runtime_error("Backend 'consume' function does not exist or is not callable");
+        }
     }
 
-    PyGILState_STATE gstate;
-    gstate = PyGILState_Ensure();
     PyOS_sighandler_t sighandler = PyOS_getsig(SIGINT);
     import_array();
     PyOS_setsig(SIGINT, sighandler);
 
+    // one slot per output buffer in the ring
     for (uint i = 0; i < _oshape_types.size(); ++i)
     {
-        _host_lists.push_back(initPyList());
-        _dev_lists.push_back(initPyList());
+        _host_lists.push_back(initPyList(_bufferCount));
+        _dev_lists.push_back(initPyList(_bufferCount));
+    }
+
+    // the lists never change, only their items, so the arguments of every
+    // call can be built up front
+    if (_f_consume_batch != NULL) {
+        PyObject* host_tuple = PyTuple_New(_host_lists.size());
+        PyObject* dev_tuple  = PyTuple_New(_dev_lists.size());
+        for (uint i = 0; i < _host_lists.size(); ++i) {
+            Py_INCREF(_host_lists[i]);
+            PyTuple_SetItem(host_tuple, i, _host_lists[i]);
+            Py_INCREF(_dev_lists[i]);
+            PyTuple_SetItem(dev_tuple, i, _dev_lists[i]);
+        }
+        for (int b = 0; b < _bufferCount; ++b) {
+            _batch_args.push_back(Py_BuildValue("iOO", b, host_tuple, dev_tuple));
+        }
+        Py_DECREF(host_tuple);
+        Py_DECREF(dev_tuple);
+    } else {
+        for (uint i = 0; i < _host_lists.size(); ++i) {
+            _consume_args.emplace_back();
+            for (int b = 0; b < _bufferCount; ++b) {
+                _consume_args[i].push_back(Py_BuildValue("iOO", b, _host_lists[i], _dev_lists[i]));
+            }
+        }
     }
 
     PyGILState_Release(gstate);
@@ -98,7 +136,17 @@ python_backend::~python_backend()
         Py_XDECREF(d);
     }
 
+    for (auto a: _batch_args) {
+        Py_XDECREF(a);
+    }
+    for (auto& args: _consume_args) {
+        for (auto a: args) {
+            Py_XDECREF(a);
+        }
+    }
+
     Py_XDECREF(_f_consume);
+    Py_XDECREF(_f_consume_batch);
     Py_XDECREF(_py_obj_backend);
     PyGILState_Release(gstate);
 
@@ -124,25 +172,30 @@ bool python_backend::use_pinned_memory()
 // Copy to device.
 void python_backend::call_backend_transfer(buffer_out_array &outBuf, int bufIdx)
 {
-    PyGILState_STATE gstate;
-    gstate = PyGILState_Ensure();
-
     affirm(_host_lists.size() == _oshape_types.size(), "host lists size does not match oshape size");
     affirm(_dev_lists.size() == _host_lists.size(), "dev list size does not match host lists size");
+    affirm(bufIdx >= 0 && bufIdx < _bufferCount, "buffer index out of range");
+
+    PyGILState_STATE gstate;
+    gstate = PyGILState_Ensure();
 
     for (uint i=0; i<_host_lists.size(); i++) {
         wrap_buffer_pool(_host_lists[i], outBuf[i], bufIdx, _oshape_types[i]);
-        PyObject* pArgs  = Py_BuildValue("iOO", bufIdx, _host_lists[i], _dev_lists[i]);
+    }
 
-        if (pArgs == NULL) {
-            throw std::runtime_error("Unable to build args");
-        }
-        PyObject* pRes = PyObject_CallObject(_f_consume, pArgs);
+    auto call = [](PyObject* f, PyObject* args) {
+        PyObject* pRes = PyObject_CallObject(f, args);
         if (!pRes) {
             PyErr_Print();
         }
-        Py_XDECREF(pArgs);
         Py_XDECREF(pRes);
+    };
+    if (_f_consume_batch != NULL) {
+        call(_f_consume_batch, _batch_args[bufIdx]);
+    } else {
+        for (uint i=0; i<_host_lists.size(); i++) {
+            call(_f_consume, _consume_args[i][bufIdx]);
+        }
     }
     PyGILState_Release(gstate);
 }
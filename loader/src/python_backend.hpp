@@ -22,25 +22,37 @@
 #include "buffer_in.hpp"
 #include "util.hpp"
 #include "buffer_out.hpp"
+#include "backend.hpp"
 
 namespace nervana {
     class python_backend;
 }
 
-class nervana::python_backend {
+/* python_backend
+ *
+ * Hands minibatches to a python object.  Each output buffer is wrapped once
+ * as a numpy array in a host list, and the backend fills the matching slot
+ * of a device list.  A backend with consume_batch(buf_index, host_tuple,
+ * dev_tuple) gets one call per minibatch with a tuple of every output's
+ * lists; otherwise consume(buf_index, host_list, dev_list) is called once per
+ * output.  The argument tuples are built once per ring slot and reused.
+ *
+ */
+class nervana::python_backend : public nervana::backend {
 public:
-    python_backend(PyObject*, const std::vector<nervana::shape_type>&, int);
+    python_backend(PyObject*, const std::vector<nervana::shape_type>&, int batchSize, int bufferCount = 2);
     ~python_backend();
 
-    bool use_pinned_memory();
-    void call_backend_transfer(nervana::buffer_out_array &outBuf, int bufIdx);
+    bool use_pinned_memory() override;
+    void call_backend_transfer(nervana::buffer_out_array &outBuf, int bufIdx) override;
     PyObject* get_host_tuple(int bufIdx);
     PyObject* get_shapes();
     const std::vector<nervana::shape_type>& _oshape_types;
     int                         _batchSize;
+    int                         _bufferCount;
 private:
     python_backend() = delete;
-    PyObject* initPyList(int length=2);
+    PyObject* initPyList(int length);
     void wrap_buffer_pool(PyObject *list, nervana::buffer_out *buf, int bufIdx,
                           const nervana::shape_type& shape_type);
 
@@ -50,4 +62,9 @@ private:
     std::vector<PyObject*>      _dev_lists;
 
     PyObject*                   _f_consume = NULL;
+    PyObject*                   _f_consume_batch = NULL;
+
+    // call arguments for each ring slot, per output for consume
+    std::vector<PyObject*>                  _batch_args;
+    std::vector<std::vector<PyObject*>>     _consume_args;
 };
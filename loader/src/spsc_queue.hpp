@@ -0,0 +1,78 @@
+/*
+ Copyright 2016 Nervana Systems Inc.
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+namespace nervana {
+    template<typename T> class spsc_queue;
+}
+
+/* spsc_queue
+ *
+ * A bounded ring for handing values from exactly one producer thread to
+ * exactly one consumer thread without locks.  try_push and try_pop never
+ * block; pair the queue with an event_count to sleep while it is empty or
+ * full.
+ *
+ */
+template<typename T>
+class nervana::spsc_queue {
+public:
+    explicit spsc_queue(size_t capacity)
+    : _slots(capacity + 1)
+    {
+    }
+
+    bool try_push(const T& value)
+    {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+        size_t next = advance(tail);
+        if (next == _head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        _slots[tail] = value;
+        _tail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    bool try_pop(T& value)
+    {
+        size_t head = _head.load(std::memory_order_relaxed);
+        if (head == _tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = _slots[head];
+        _head.store(advance(head), std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const
+    {
+        return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire);
+    }
+
+private:
+    size_t advance(size_t index) const
+    {
+        return index + 1 == _slots.size() ? 0 : index + 1;
+    }
+
+    std::vector<T>      _slots;
+    std::atomic<size_t> _head{0};
+    std::atomic<size_t> _tail{0};
+};
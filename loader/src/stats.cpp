@@ -0,0 +1,201 @@
+/*
+ Copyright 2016 Nervana Systems Inc.
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include <algorithm>
+#include <mutex>
+
+#include "stats.hpp"
+
+using namespace std;
+using namespace nervana;
+
+namespace {
+    const int stage_count = (int)stats::stage::count;
+
+    struct thread_histograms {
+        stats::histogram histograms[stage_count];
+    };
+
+    // histograms of live threads, and the merged counts of exited ones
+    struct registry {
+        mutex                       lock;
+        vector<thread_histograms*>  live;
+        vector<uint64_t>            retired[stage_count];
+        uint64_t                    retired_sum[stage_count] = {};
+        uint64_t                    retired_max[stage_count] = {};
+
+        registry()
+        {
+            for (auto& r : retired) {
+                r.resize(stats::histogram::buckets);
+            }
+        }
+    };
+
+    registry& get_registry()
+    {
+        // never destroyed, threads may still exit after static destructors
+        static registry* r = new registry();
+        return *r;
+    }
+
+    struct thread_owner {
+        thread_histograms* histograms;
+
+        thread_owner() : histograms(new thread_histograms())
+        {
+            registry& r = get_registry();
+            lock_guard<mutex> lock(r.lock);
+            r.live.push_back(histograms);
+        }
+
+        ~thread_owner()
+        {
+            registry& r = get_registry();
+            {
+                lock_guard<mutex> lock(r.lock);
+                for (int s = 0; s < stage_count; s++) {
+                    histograms->histograms[s].merge(r.retired[s], r.retired_sum[s], r.retired_max[s]);
+                }
+                r.live.erase(find(r.live.begin(), r.live.end(), histograms));
+            }
+            delete histograms;
+        }
+    };
+
+    thread_histograms& local()
+    {
+        static thread_local thread_owner owner;
+        return *owner.histograms;
+    }
+}
+
+const char* stats::name(stage s)
+{
+    switch (s) {
+    case stage::block_read:         return "block_read";
+    case stage::batch_read:         return "batch_read";
+    case stage::extract:            return "extract";
+    case stage::transform:          return "transform";
+    case stage::load:               return "load";
+    case stage::record:             return "record";
+    case stage::post_process:       return "post_process";
+    case stage::backend_transfer:   return "backend_transfer";
+    default:                        return "unknown";
+    }
+}
+
+const int stats::histogram::buckets;
+
+stats::histogram::histogram()
+: _sum(0), _max(0)
+{
+    for (auto& c : _counts) {
+        c.store(0, memory_order_relaxed);
+    }
+}
+
+int stats::histogram::bucket(uint64_t ns)
+{
+    if (ns < 8) {
+        return ns;
+    }
+    int e = 63 - __builtin_clzll(ns);
+    int sub = (ns >> (e - 3)) & 7;
+    return (e - 2) * 8 + sub;
+}
+
+uint64_t stats::histogram::lower_bound(int bucket)
+{
+    if (bucket < 8) {
+        return bucket;
+    }
+    int e = bucket / 8 + 2;
+    return uint64_t(8 + bucket % 8) << (e - 3);
+}
+
+void stats::histogram::add(uint64_t ns)
+{
+    // a single writer needs no read-modify-write, only untorn stores
+    auto& c = _counts[bucket(ns)];
+    c.store(c.load(memory_order_relaxed) + 1, memory_order_relaxed);
+    _sum.store(_sum.load(memory_order_relaxed) + ns, memory_order_relaxed);
+    if (ns > _max.load(memory_order_relaxed)) {
+        _max.store(ns, memory_order_relaxed);
+    }
+}
+
+void stats::histogram::merge(vector<uint64_t>& totals, uint64_t& sum, uint64_t& max) const
+{
+    for (int i = 0; i < buckets; i++) {
+        totals[i] += _counts[i].load(memory_order_relaxed);
+    }
+    sum += _sum.load(memory_order_relaxed);
+    max = std::max<uint64_t>(max, _max.load(memory_order_relaxed));
+}
+
+void stats::record(stage s, uint64_t ns)
+{
+    local().histograms[(int)s].add(ns);
+}
+
+nlohmann::json stats::snapshot()
+{
+    registry& r = get_registry();
+    nlohmann::json rc = nlohmann::json::object();
+
+    lock_guard<mutex> lock(r.lock);
+    for (int s = 0; s < stage_count; s++) {
+        vector<uint64_t> totals = r.retired[s];
+        uint64_t sum = r.retired_sum[s];
+        uint64_t max = r.retired_max[s];
+        for (auto h : r.live) {
+            h->histograms[s].merge(totals, sum, max);
+        }
+
+        uint64_t count = 0;
+        for (auto c : totals) {
+            count += c;
+        }
+        if (count == 0) {
+            continue;
+        }
+
+        // quantiles report the middle of the bucket they fall in
+        auto quantile = [&](double q) {
+            uint64_t rank = q * (count - 1);
+            uint64_t seen = 0;
+            for (int i = 0; i < histogram::buckets; i++) {
+                seen += totals[i];
+                if (seen > rank) {
+                    uint64_t lo = histogram::lower_bound(i);
+                    uint64_t hi = i + 1 < histogram::buckets ? histogram::lower_bound(i + 1) : lo;
+                    return std::min<double>((lo + hi) / 2.0, max) / 1000.0;
+                }
+            }
+            return max / 1000.0;
+        };
+
+        rc[name((stage)s)] = {
+            {"count", count},
+            {"mean_us", double(sum) / count / 1000.0},
+            {"p50_us", quantile(0.5)},
+            {"p90_us", quantile(0.9)},
+            {"p99_us", quantile(0.99)},
+            {"max_us", max / 1000.0}
+        };
+    }
+    return rc;
+}
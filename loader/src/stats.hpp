@@ -0,0 +1,113 @@
+/*
+ Copyright 2016 Nervana Systems Inc.
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "json.hpp"
+
+/* stats
+ *
+ * Latency histograms for the stages of the loader pipeline.  Every thread
+ * records into histograms of its own, so the hot path is a clock read and
+ * a couple of plain stores; snapshot() merges them, together with those of
+ * threads that have since exited.  The histograms are process wide.
+ *
+ * Buckets are log-linear: exact below 8ns, then 8 per power of two, which
+ * keeps every quantile within 12.5% of the true value.
+ *
+ */
+namespace nervana {
+    namespace stats {
+        enum class stage {
+            block_read,         // a block iterator waiting on loadBlock
+            batch_read,         // the read thread filling one minibatch
+            extract,
+            transform,
+            load,
+            record,             // one record in a decode thread, cache hits included
+            post_process,
+            backend_transfer,
+            count
+        };
+
+        const char* name(stage s);
+
+        class histogram {
+        public:
+            static const int buckets = 62 * 8;
+
+            histogram();
+
+            // only the owning thread may add
+            void add(uint64_t ns);
+
+            // add this histogram's counts to totals, which has `buckets` entries
+            void merge(std::vector<uint64_t>& totals, uint64_t& sum, uint64_t& max) const;
+
+            static int bucket(uint64_t ns);
+            static uint64_t lower_bound(int bucket);
+
+        private:
+            std::atomic<uint64_t> _counts[buckets];
+            std::atomic<uint64_t> _sum;
+            std::atomic<uint64_t> _max;
+        };
+
+        void record(stage s, uint64_t ns);
+
+        inline uint64_t now()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        // charges the time since construction, or since the last mark, to
+        // the stage given to mark
+        class split {
+        public:
+            split() : _last(now()) {}
+
+            void mark(stage s)
+            {
+                uint64_t t = now();
+                record(s, t - _last);
+                _last = t;
+            }
+
+        private:
+            uint64_t _last;
+        };
+
+        // charges its own lifetime to a stage
+        class timer {
+        public:
+            explicit timer(stage s) : _stage(s), _start(now()) {}
+            ~timer() { record(_stage, now() - _start); }
+
+        private:
+            stage    _stage;
+            uint64_t _start;
+        };
+
+        // count, mean, 50th, 90th and 99th percentile and max of every stage
+        // that has been recorded, in microseconds
+        nlohmann::json snapshot();
+    }
+}
@@ -24,6 +24,9 @@
 #include <chrono>
 #include <utility>
 #include <algorithm>
+#include <atomic>
+
+#include "cpu.hpp"
 
 namespace nervana {
     class thread_pool;
@@ -40,7 +43,7 @@ class nervana::thread_pool {
 public:
     explicit thread_pool(int count)
     : _count(count), _done(false) {
-        _stopped = new bool[count];
+        _stopped = new std::atomic<bool>[count];
         for (int i = 0; i < count; i++) {
             _stopped[i] = false;
         }
@@ -57,9 +60,15 @@ public:
     virtual void start() {
         for (int i = 0; i < _count; i++) {
             _threads.push_back(new std::thread(&thread_pool::run, this, i));
+            cpu::pin(*_threads.back(), _cpus);
         }
     }
 
+    // restrict the threads to cpus, must be called before start
+    void set_cpus(const std::vector<int>& cpus) {
+        _cpus = cpus;
+    }
+
     virtual void stop() {
         _done = true;
     }
@@ -92,6 +101,7 @@ protected:
 protected:
     int                         _count;
     std::vector<std::thread*>   _threads;
-    bool                        _done;
-    bool*                       _stopped;
+    std::atomic<bool>           _done;
+    std::atomic<bool>*          _stopped;
+    std::vector<int>            _cpus;
 };
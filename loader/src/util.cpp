@@ -148,6 +148,18 @@ size_t nervana::unbiased_round(float x)
     return rc;
 }
 
+string nervana::hash_string(const string& s)
+{
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (char c : s) {
+        h ^= (uint8_t) c;
+        h *= 0x100000001b3ull;
+    }
+    stringstream ss;
+    ss << std::hex << std::setw(16) << std::setfill('0') << h;
+    return ss.str();
+}
+
 void nervana::affirm(bool cond, const std::string& msg)
 {
     if (!cond)
@@ -63,6 +63,10 @@ namespace nervana {
     std::vector<std::string> split(const std::string& s, char delimiter);
 
     size_t unbiased_round(float f);
+
+    // 64 bit FNV-1a hash of s in hex.  Unlike std::hash it is the same on
+    // every platform and build, so it can name files that outlive them.
+    std::string hash_string(const std::string& s);
     int LevenshteinDistance(const std::string& s1, const std::string& s2);
 
     template<typename CharT, typename TraitsT = std::char_traits<CharT> >
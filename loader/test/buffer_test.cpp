@@ -16,6 +16,7 @@
 #include "gtest/gtest.h"
 
 #include "buffer_in.hpp"
+#include "buffer_pool_out.hpp"
 #include "helpers.hpp"
 
 using namespace std;
@@ -87,3 +88,103 @@ TEST(buffer, read_exception) {
         ASSERT_STREQ("expect me", e.what());
     }
 }
+
+TEST(buffer, shuffle_exception) {
+    // exceptions move with their item when a buffer is shuffled
+    buffer_in b;
+    for (int i = 0; i < 16; ++i) {
+        read(b, "x");
+    }
+    setup_buffer_exception(b);
+
+    b.shuffle(0);
+
+    int thrown = 0;
+    for (int i = 0; i < b.get_item_count(); ++i) {
+        try {
+            b.get_item(i);
+        } catch (std::exception& e) {
+            ASSERT_STREQ("expect me", e.what());
+            thrown++;
+        }
+    }
+    ASSERT_EQ(thrown, 1);
+}
+
+TEST(buffer, reuse) {
+    // storage is reused after reset unless another buffer still shares it
+    buffer_in b;
+    read(b, "abc");
+    const char* first = b.get_item(0).data();
+
+    b.reset();
+    read(b, "def");
+    ASSERT_EQ(b.get_item(0).data(), first);
+
+    buffer_in shared;
+    shared.add_item(b, 0);
+    b.reset();
+    read(b, "ghi");
+    ASSERT_NE(b.get_item(0).data(), first);
+    ASSERT_EQ(string(shared.get_item(0).data(), 3), "def");
+}
+
+TEST(buffer_pool_out, reserve) {
+    // a buffer can be decoded into while the one before it is still being
+    // finished, and buffers are published in the order they were reserved
+    buffer_pool_out pool({4}, 2);
+
+    ASSERT_EQ(pool.empty(), true);
+    int first = pool.reserve_for_write();
+    int second = pool.reserve_for_write();
+    ASSERT_NE(first, second);
+    ASSERT_EQ(pool.full(), true);
+    ASSERT_EQ(pool.empty(), true);
+
+    pool.advance_write_pos();
+    ASSERT_EQ(pool.empty(), false);
+    ASSERT_EQ(&pool.get_for_read(), &pool.get(first));
+
+    pool.advance_read_pos();
+    ASSERT_EQ(pool.full(), false);
+    ASSERT_EQ(pool.reserve_for_write(), first);
+}
+
+TEST(buffer_pool_out, exception) {
+    // exceptions follow the buffer they were written for
+    buffer_pool_out pool({4}, 2);
+
+    pool.reserve_for_write();
+    int second = pool.reserve_for_write();
+    try {
+        throw std::runtime_error("expect me");
+    } catch (std::exception& e) {
+        pool.write_exception(std::current_exception(), second);
+    }
+
+    pool.advance_write_pos();
+    EXPECT_NO_THROW(pool.reraise_exception());
+    pool.advance_read_pos();
+
+    pool.advance_write_pos();
+    EXPECT_THROW(pool.reraise_exception(), std::runtime_error);
+}
+
+TEST(buffer_pool_out, ring) {
+    // a deeper ring holds that many ready minibatches before writers wait
+    buffer_pool_out pool({4}, 2, false, 5);
+
+    for (int i = 0; i < 5; ++i) {
+        ASSERT_EQ(pool.full(), false);
+        ASSERT_EQ(pool.reserve_for_write(), i);
+        pool.advance_write_pos();
+    }
+    ASSERT_EQ(pool.full(), true);
+
+    for (int i = 0; i < 5; ++i) {
+        ASSERT_EQ(&pool.get_for_read(), &pool.get(i));
+        pool.advance_read_pos();
+    }
+    ASSERT_EQ(pool.empty(), true);
+    ASSERT_EQ(pool.reserve_for_write(), 0);
+}
@@ -0,0 +1,320 @@
+/*
+ Copyright 2016 Nervana Systems Inc.
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+/* loader_bench
+ *
+ * Drives a loader_core with a consumer that drops every minibatch, so
+ * throughput can be measured without Python or a device.  Datasets come
+ * from a loader config or are generated once into a directory and reused.
+ * For each decode thread count it reports records/s, MB/s and the mean
+ * time per record of each stage.
+ *
+ */
+
+#include <sys/stat.h>
+#include <errno.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+#include "loader_core.hpp"
+#include "wav_data.hpp"
+#include "cpu.hpp"
+#include "stats.hpp"
+#include "util.hpp"
+
+using namespace std;
+using namespace nervana;
+
+namespace {
+    // the minibatch is only read from the output buffers, so the byte size
+    // of one record is the sum over the outputs of the item size
+    size_t record_bytes(const loader_core& core)
+    {
+        size_t bytes = 0;
+        for (auto& o : core.oshapes()) {
+            bytes += o.get_byte_size();
+        }
+        return bytes;
+    }
+
+    bool exists(const string& path)
+    {
+        struct stat st;
+        return stat(path.c_str(), &st) == 0;
+    }
+
+    void make_directories(const string& path)
+    {
+        // like mkdir -p
+        for (size_t end = path.find('/', 1); ; end = path.find('/', end + 1)) {
+            string dir = path.substr(0, end);
+            if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+                throw runtime_error("unable to create " + dir + " " + strerror(errno));
+            }
+            if (end == string::npos) {
+                break;
+            }
+        }
+    }
+
+    void write_file(const string& path, const void* data, size_t size)
+    {
+        ofstream f(path, ios::binary);
+        f.write((const char*)data, size);
+        affirm(f.good(), "unable to write " + path);
+    }
+
+    cv::Mat render_image(int number, int rows, int cols, mt19937& rand)
+    {
+        // colored blocks and the record number, so images don't compress to nothing
+        cv::Mat image(rows, cols, CV_8UC3);
+        uniform_int_distribution<int> color(0, 255);
+        for (int y = 0; y < rows; y += 32) {
+            for (int x = 0; x < cols; x += 32) {
+                cv::rectangle(image, cv::Rect(x, y, 32, 32),
+                              cv::Scalar(color(rand), color(rand), color(rand)), CV_FILLED);
+            }
+        }
+        cv::putText(image, to_string(number), cv::Point(cols / 4, rows / 2),
+                    cv::FONT_HERSHEY_PLAIN, rows / 64.0, cv::Scalar(0, 0, 0), 2);
+        return image;
+    }
+
+    const vector<string> bbox_labels = {"person", "dog", "cat", "car"};
+
+    // writes `items` records of `media` to dir, unless a manifest from an
+    // earlier run is there, and returns the loader config to read them with
+    nlohmann::json synthetic_config(const string& media, const string& dir, int items)
+    {
+        nlohmann::json js;
+        string manifest = dir + "/manifest.csv";
+        if (media == "image") {
+            js = {{"type", "image,label"},
+                  {"image", {{"height", 224}, {"width", 224}, {"channels", 3}, {"flip_enable", true}}},
+                  {"label", {{"binary", false}}}};
+        } else if (media == "bbox") {
+            js = {{"type", "image,boundingbox"},
+                  {"image", {{"height", 224}, {"width", 224}, {"channels", 3}}},
+                  {"boundingbox", {{"height", 224}, {"width", 224}, {"max_bbox_count", 8},
+                                   {"labels", bbox_labels}}}};
+        } else if (media == "audio") {
+            js = {{"type", "audio,label"},
+                  {"audio", {{"max_duration", "2000 milliseconds"},
+                             {"frame_length", "1024 samples"},
+                             {"frame_stride", "256 samples"},
+                             {"sample_freq_hz", 16000},
+                             {"feature_type", "specgram"}}},
+                  {"label", {{"binary", false}}}};
+        } else if (media == "video") {
+            js = {{"type", "video,label"},
+                  {"video", {{"max_frame_count", 5}, {"frame", {{"height", 112}, {"width", 112}}}}},
+                  {"label", {{"binary", false}}}};
+        } else {
+            throw invalid_argument("unknown media '" + media + "', use image, bbox, audio or video");
+        }
+        js["manifest_filename"] = manifest;
+        js["minibatch_size"] = 128;
+
+        if (exists(manifest)) {
+            return js;
+        }
+        make_directories(dir);
+        cout << "generating " << items << " " << media << " records in " << dir << endl;
+
+        mt19937 rand(0);
+        ofstream m(manifest + ".tmp");
+        for (int i = 0; i < items; i++) {
+            string datum = dir + "/" + to_string(i);
+            string target = dir + "/" + to_string(i);
+            if (media == "image" || media == "bbox") {
+                datum += ".jpg";
+                affirm(cv::imwrite(datum, render_image(i, 256, 340, rand)), "unable to write " + datum);
+            } else if (media == "audio") {
+                datum += ".wav";
+                wav_data wav(sinewave_generator(200 + 10 * (i % 50)), 2, 16000, false);
+                wav.write_to_file(datum);
+            } else {
+                datum += ".avi";
+                stringstream cmd;
+                cmd << "ffmpeg -loglevel quiet -hide_banner -f lavfi -i testsrc=duration=1:size=176x144:rate=25";
+                cmd << " -c:v mjpeg -q:v 3 -y " << datum;
+                affirm(system(cmd.str().c_str()) == 0, "video datasets need ffmpeg");
+            }
+
+            if (media == "bbox") {
+                target += ".json";
+                nlohmann::json boxes = nlohmann::json::array();
+                for (int b = 0; b < 1 + i % 4; b++) {
+                    int x = 20 + 40 * b, y = 30 + 20 * b;
+                    boxes.push_back({{"bndbox", {{"xmin", x}, {"ymin", y}, {"xmax", x + 80}, {"ymax", y + 60}}},
+                                     {"name", bbox_labels[(i + b) % bbox_labels.size()]}});
+                }
+                nlohmann::json meta = {{"object", boxes}, {"size", {{"depth", 3}, {"height", 256}, {"width", 340}}}};
+                string text = meta.dump();
+                write_file(target, text.data(), text.size());
+            } else {
+                target += ".txt";
+                string text = to_string(i % 10);
+                write_file(target, text.data(), text.size());
+            }
+            m << datum << "," << target << "\n";
+        }
+        m.close();
+        affirm(!m.fail(), "unable to write " + manifest + ".tmp");
+        if (rename((manifest + ".tmp").c_str(), manifest.c_str()) != 0) {
+            throw runtime_error("unable to write " + manifest + " " + strerror(errno));
+        }
+        return js;
+    }
+
+    // mean bytes per record on disk, from the files the manifest lists
+    double input_bytes(const string& manifest)
+    {
+        ifstream m(manifest);
+        string line;
+        size_t bytes = 0, records = 0;
+        while (getline(m, line) && records < 1000) {
+            for (auto& path : split(line, ',')) {
+                struct stat st;
+                if (stat(path.c_str(), &st) == 0) {
+                    bytes += st.st_size;
+                }
+            }
+            records++;
+        }
+        return records ? double(bytes) / records : 0;
+    }
+
+    void usage()
+    {
+        cout << "usage: loader_bench [--config FILE | --media image|bbox|audio|video] [options]\n"
+                "  --config FILE    loader config json, as passed to DataLoader\n"
+                "  --media NAME     generate, or reuse, a synthetic dataset\n"
+                "  --dir DIR        where synthetic datasets live (/tmp/loader_bench)\n"
+                "  --items N        records in a synthetic dataset (2000)\n"
+                "  --batches N      minibatches timed per thread count (100)\n"
+                "  --threads LIST   decode thread counts, e.g. 1,2,4 or 1-8\n"
+                "                   (powers of two up to the available cpus)\n";
+    }
+}
+
+int main(int argc, char** argv)
+{
+    string config_file, media = "image", dir = "/tmp/loader_bench";
+    int items = 2000, batches = 100;
+    vector<int> threads;
+    try {
+        for (int i = 1; i < argc; i++) {
+            string arg = argv[i];
+            auto value = [&]() {
+                affirm(i + 1 < argc, arg + " needs a value");
+                return string(argv[++i]);
+            };
+            if (arg == "--config")       config_file = value();
+            else if (arg == "--media")   media = value();
+            else if (arg == "--dir")     dir = value();
+            else if (arg == "--items")   items = stoi(value());
+            else if (arg == "--batches") batches = stoi(value());
+            else if (arg == "--threads") threads = cpu::parse_list(value());
+            else {
+                usage();
+                return arg == "--help" ? 0 : 1;
+            }
+        }
+
+        nlohmann::json config;
+        if (config_file.size() > 0) {
+            ifstream f(config_file);
+            affirm(f.good(), "unable to read " + config_file);
+            f >> config;
+        } else {
+            config = synthetic_config(media, dir + "/" + media, items);
+        }
+        if (threads.empty()) {
+            for (int n = 1; n < cpu::available(); n *= 2) {
+                threads.push_back(n);
+            }
+            threads.push_back(cpu::available());
+        }
+
+        double in_bytes = input_bytes(config["manifest_filename"]);
+        cout << "threads  records/s    in MB/s   out MB/s";
+        for (int s = 0; s < (int)stats::stage::count; s++) {
+            cout << setw(12) << stats::name((stats::stage)s);
+        }
+        cout << "   (us per record or block)" << endl;
+
+        vector<const buffer_out*> outputs;
+        for (int n : threads) {
+            config["decode_thread_count"] = n;
+            loader_core core(config.dump());
+            core.start();
+            // let the queues fill and the caches warm before timing
+            for (int i = 0; i < 5; i++) {
+                core.next(outputs);
+                core.release();
+            }
+
+            auto before = stats::snapshot();
+            auto start = chrono::steady_clock::now();
+            for (int i = 0; i < batches; i++) {
+                core.next(outputs);
+                core.release();
+            }
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            auto after = stats::snapshot();
+
+            double records = double(batches) * core.batch_size() / seconds;
+            cout << setw(7) << n << setw(11) << fixed << setprecision(1) << records
+                 << setw(11) << records * in_bytes / 1e6
+                 << setw(11) << records * record_bytes(core) / 1e6;
+            for (int s = 0; s < (int)stats::stage::count; s++) {
+                // the histograms accumulate, so take the mean of this run
+                // from the change in count and total
+                string name = stats::name((stats::stage)s);
+                auto total = [&](nlohmann::json& js) {
+                    return js.count(name) ? js[name]["count"].get<double>() * js[name]["mean_us"].get<double>() : 0.0;
+                };
+                auto count = [&](nlohmann::json& js) {
+                    return js.count(name) ? js[name]["count"].get<double>() : 0.0;
+                };
+                double delta = count(after) - count(before);
+                cout << setw(12);
+                if (delta > 0) {
+                    cout << (total(after) - total(before)) / delta;
+                } else {
+                    cout << "-";
+                }
+            }
+            cout << endl;
+            core.stop();
+        }
+    } catch (std::exception& e) {
+        cerr << "loader_bench: " << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
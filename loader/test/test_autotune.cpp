@@ -0,0 +1,102 @@
+/*
+ Copyright 2016 Nervana Systems Inc.
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include "gtest/gtest.h"
+
+#include "autotune.hpp"
+#include "buffer_pool_in.hpp"
+
+using namespace std;
+using namespace nervana;
+
+namespace {
+    // a window of 8 minibatches taking 1 second
+    const uint64_t second = 1000000000;
+    bool window(autotuner& tuner, double consumer_wait, double input_wait)
+    {
+        return tuner.update(second, consumer_wait * second, input_wait * second, 8);
+    }
+}
+
+TEST(autotune, grow) {
+    autotuner tuner(2, 8, 2, 4, 64);
+
+    // decoding waits for reads, so read further ahead
+    window(tuner, 0.5, 0.5);
+    EXPECT_EQ(2, tuner.threads());
+    EXPECT_EQ(3, tuner.depth());
+
+    // decoding itself is slow, so add threads
+    window(tuner, 0.5, 0.0);
+    EXPECT_EQ(3, tuner.threads());
+    window(tuner, 0.5, 0.0);
+    window(tuner, 0.5, 0.0);
+    window(tuner, 0.5, 0.0);
+    window(tuner, 0.5, 0.0);
+    EXPECT_EQ(7, tuner.threads());
+    window(tuner, 0.5, 0.0);
+    EXPECT_EQ(8, tuner.threads());
+
+    // and no further
+    EXPECT_FALSE(window(tuner, 0.5, 0.0));
+    EXPECT_EQ(8, tuner.threads());
+    EXPECT_TRUE(tuner.done());
+
+    window(tuner, 0.5, 0.5);
+    EXPECT_EQ(3, tuner.depth());
+}
+
+TEST(autotune, shrink) {
+    autotuner tuner(8, 8, 2, 4, 64);
+
+    // the consumer never waits, so give threads back
+    window(tuner, 0.0, 0.0);
+    window(tuner, 0.0, 0.0);
+    EXPECT_EQ(6, tuner.threads());
+
+    // until it does, then take the last one back and stay there
+    window(tuner, 0.2, 0.0);
+    EXPECT_EQ(7, tuner.threads());
+    window(tuner, 0.0, 0.0);
+    window(tuner, 0.0, 0.0);
+    EXPECT_EQ(7, tuner.threads());
+
+    // in between, leave things alone
+    window(tuner, 0.02, 0.0);
+    EXPECT_EQ(7, tuner.threads());
+    EXPECT_EQ(2, tuner.depth());
+}
+
+TEST(autotune, read_depth) {
+    buffer_pool_in pool(1, 4);
+    pool.set_depth(2);
+    pool.get_for_write();
+    pool.advance_write_pos();
+    ASSERT_FALSE(pool.full());
+    pool.get_for_write();
+    pool.advance_write_pos();
+    ASSERT_TRUE(pool.full());
+
+    pool.set_depth(3);
+    ASSERT_FALSE(pool.full());
+    pool.set_depth(1);
+    ASSERT_TRUE(pool.full());
+    pool.advance_read_pos();
+    ASSERT_TRUE(pool.full());
+    pool.advance_read_pos();
+    ASSERT_FALSE(pool.full());
+
+    ASSERT_THROW(pool.set_depth(5), runtime_error);
+}
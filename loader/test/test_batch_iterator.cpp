@@ -87,3 +87,32 @@ TEST(minibatch_iterator, shuffled) {
     assert_vector_unique(words_a);
 
 }
+
+TEST(minibatch_iterator, state) {
+    // a second iterator moved to the state of the first, part way through
+    // a block in its second epoch, reads the same records from there on
+    auto mbl = make_shared<block_loader_alphabet>(3);
+    batch_iterator a(make_shared<block_iterator_shuffled>(mbl, 0), 13);
+    batch_iterator b(make_shared<block_iterator_shuffled>(mbl, 0), 13);
+
+    buffer_in_array skipped(2);
+    for(int i = 0; i < 8; ++i) {
+        a.read(skipped);
+    }
+    nlohmann::json state = a.get_state();
+    ASSERT_NE(0, state["item"].get<int>());
+
+    buffer_in_array bp_a(2);
+    buffer_in_array bp_b(2);
+    b.set_state(state);
+    EXPECT_EQ(state, b.get_state());
+    for(int i = 0; i < 8; ++i) {
+        a.read(bp_a);
+        b.read(bp_b);
+    }
+    EXPECT_EQ(buffer_to_vector_of_strings(*bp_a[0]), buffer_to_vector_of_strings(*bp_b[0]));
+
+    // a state for a different seed is refused
+    batch_iterator c(make_shared<block_iterator_shuffled>(mbl, 1), 13);
+    EXPECT_THROW(c.set_state(state), runtime_error);
+}
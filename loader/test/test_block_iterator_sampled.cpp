@@ -0,0 +1,116 @@
+/*
+ Copyright 2016 Nervana Systems Inc.
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include <map>
+#include <sys/stat.h>
+
+#include "gtest/gtest.h"
+
+#include "helpers.hpp"
+#include "block_iterator_sampled.hpp"
+#include "block_loader_cpio_cache.hpp"
+
+using namespace std;
+using namespace nervana;
+
+namespace {
+    // draws from every record read in `epochs` epochs, by record number
+    map<int64_t, int> count_draws(block_iterator_sampled& it, block_loader& loader, int epochs)
+    {
+        map<int64_t, int> draws;
+        for (uint i = 0; i < epochs * loader.shardBlockCount(); ++i) {
+            buffer_in_array bp(2);
+            it.read(bp);
+            for (int j = 0; j < bp[0]->get_item_count(); ++j) {
+                span word = bp[0]->get_item(j);
+                int64_t record = (word[0] - 'A') * loader.blockSize() + (word[1] - 'a');
+                EXPECT_EQ(record, bp[0]->get_record(j));
+                EXPECT_EQ(record, bp[1]->get_record(j));
+                ++draws[record];
+            }
+        }
+        return draws;
+    }
+}
+
+TEST(block_iterator_sampled, weights) {
+    // records 0 to 3 weigh 3, 1, 0 and 4, the rest nothing
+    auto mbl = make_shared<block_loader_alphabet>(4);
+    vector<float> weights(mbl->objectCount(), 0);
+    weights[0] = 3;
+    weights[1] = 1;
+    weights[3] = 4;
+    block_iterator_sampled bis(mbl, weights, 0);
+
+    // an epoch draws as many records as there are
+    map<int64_t, int> draws = count_draws(bis, *mbl, 20);
+    ASSERT_EQ(3, draws.size());
+    int total = draws[0] + draws[1] + draws[3];
+    EXPECT_EQ(20 * mbl->objectCount(), total);
+    EXPECT_NEAR(3.0 / 8, (double)draws[0] / total, 0.02);
+    EXPECT_NEAR(1.0 / 8, (double)draws[1] / total, 0.02);
+    EXPECT_NEAR(4.0 / 8, (double)draws[3] / total, 0.02);
+}
+
+TEST(block_iterator_sampled, balanced) {
+    vector<float> weights = block_iterator_sampled::balanced({"cat", "dog", "cat", "cat", "eel"});
+    vector<float> expected = {1.0f / 3, 1, 1.0f / 3, 1.0f / 3, 1};
+    EXPECT_EQ(expected, weights);
+}
+
+TEST(block_iterator_sampled, shards) {
+    // a shard draws only its own records
+    auto mbl = make_shared<block_loader_alphabet>(4, 3, 1);
+    block_iterator_sampled bis(mbl, vector<float>(mbl->objectCount(), 1), 0);
+    for (auto& d : count_draws(bis, *mbl, 5)) {
+        EXPECT_TRUE(mbl->inShard(d.first / 4));
+    }
+}
+
+TEST(block_iterator_sampled, state) {
+    // a second iterator moved to the state of the first draws the same
+    auto mbl = make_shared<block_loader_alphabet>(4);
+    vector<float> weights(mbl->objectCount(), 1);
+    block_iterator_sampled a(mbl, weights, 5);
+    block_iterator_sampled b(mbl, weights, 5);
+    count_draws(a, *mbl, 1);
+    buffer_in_array skipped(2);
+    a.read(skipped);
+
+    b.set_state(a.get_state());
+    buffer_in_array bp_a(2);
+    buffer_in_array bp_b(2);
+    for (int i = 0; i < 30; ++i) {
+        a.read(bp_a);
+        b.read(bp_b);
+    }
+    EXPECT_EQ(buffer_to_vector_of_strings(*bp_a[0]), buffer_to_vector_of_strings(*bp_b[0]));
+}
+
+TEST(block_iterator_sampled, fills_cache) {
+    // records drawn through the cache come out the same and leave the
+    // blocks they were drawn from in it
+    string hash = block_loader_random::randomString();
+    auto mbl = make_shared<block_loader_alphabet>(4);
+    auto cache = make_shared<block_loader_cpio_cache>("/tmp", hash, "version123", mbl);
+    block_iterator_sampled bis(cache, vector<float>(mbl->objectCount(), 1), 0);
+    map<int64_t, int> draws = count_draws(bis, *cache, 2);
+    ASSERT_LT(0, draws.size());
+    for (auto& d : draws) {
+        struct stat stats;
+        string filename = "/tmp/" + hash + "_version123/" + to_string(d.first / 4) + "-4.cpio";
+        EXPECT_EQ(0, stat(filename.c_str(), &stats)) << filename;
+    }
+}
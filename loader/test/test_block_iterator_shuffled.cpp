@@ -13,6 +13,8 @@
  limitations under the License.
 */
 
+#include <set>
+
 #include "gtest/gtest.h"
 
 #include "helpers.hpp"
@@ -66,3 +68,117 @@ TEST(block_iterator_shuffled, shuffled_block) {
     // have loaded an entire 'epoch' and have no duplicates
     assert_vector_unique(words_a);
 }
+
+TEST(block_iterator_shuffled, record_numbers) {
+    // records keep their position in the dataset through the shuffle
+    auto mbl = make_shared<block_loader_alphabet>(5);
+    block_iterator_shuffled bis(mbl, 0);
+    buffer_in_array bp(2);
+
+    for(int i = 0; i < mbl->blockCount(); ++i) {
+        bis.read(bp);
+    }
+
+    for (int i = 0; i < bp[0]->get_item_count(); ++i) {
+        span word = bp[0]->get_item(i);
+        int64_t expected = (word[0] - 'A') * 5 + (word[1] - 'a');
+        ASSERT_EQ(bp[0]->get_record(i), expected);
+        ASSERT_EQ(bp[1]->get_record(i), expected);
+    }
+}
+
+TEST(block_iterator_shuffled, shards) {
+    // shards with the same seed each read their own blocks, in the order
+    // the blocks have when the whole dataset is shuffled
+    auto whole = make_shared<block_loader_alphabet>(2);
+    block_iterator_shuffled unsharded(whole, 7);
+    vector<shared_ptr<block_iterator_shuffled>> shards;
+    for (uint i = 0; i < 3; ++i) {
+        shards.push_back(make_shared<block_iterator_shuffled>(
+            make_shared<block_loader_alphabet>(2, 3, i), 7));
+    }
+
+    // the block a read loaded, from the first letter of its words
+    auto next_block = [](block_iterator_shuffled& it) {
+        buffer_in_array bp(1);
+        it.read(bp);
+        return (uint)(bp[0]->get_item(0)[0] - 'A');
+    };
+
+    for (int epoch = 0; epoch < 2; ++epoch) {
+        vector<vector<uint>> expected(3);
+        for (uint i = 0; i < whole->blockCount(); ++i) {
+            uint block = next_block(unsharded);
+            expected[block % 3].push_back(block);
+        }
+        for (uint i = 0; i < 3; ++i) {
+            vector<uint> blocks;
+            for (uint b = 0; b < expected[i].size(); ++b) {
+                blocks.push_back(next_block(*shards[i]));
+            }
+            EXPECT_EQ(expected[i], blocks);
+        }
+    }
+}
+
+TEST(block_iterator_shuffled, equal_shards) {
+    // 26 blocks over 4 equal shards are 6 blocks each, which shard's own
+    // blocks are left out changes from epoch to epoch
+    set<uint> left_out;
+    for (uint i = 0; i < 4; ++i) {
+        auto loader = make_shared<block_loader_alphabet>(2, 4, i, true);
+        ASSERT_EQ(6, loader->shardBlockCount());
+        block_iterator_shuffled bis(loader, 3);
+        for (int epoch = 0; epoch < 4; ++epoch) {
+            set<uint> blocks;
+            for (uint b = 0; b < 6; ++b) {
+                buffer_in_array bp(1);
+                bis.read(bp);
+                uint block = bp[0]->get_item(0)[0] - 'A';
+                EXPECT_TRUE(loader->inShard(block));
+                blocks.insert(block);
+            }
+            EXPECT_EQ(6, blocks.size());
+            for (uint block = i; block < 26; block += 4) {
+                if (blocks.count(block) == 0) {
+                    left_out.insert(block);
+                }
+            }
+        }
+    }
+    EXPECT_GT(left_out.size(), 2);
+}
+
+TEST(block_iterator_shuffled, window) {
+    // a window of 4 blocks mixes their records, and the last window of
+    // the epoch holds the 2 blocks left over
+    auto mbl = make_shared<block_loader_alphabet>(5);
+    block_iterator_shuffled bis(mbl, 0, 4);
+
+    vector<string> epoch;
+    for (int i = 0; i < 7; ++i) {
+        buffer_in_array bp(2);
+        bis.read(bp);
+        vector<string> words = buffer_to_vector_of_strings(*bp[0]);
+        ASSERT_EQ(i < 6 ? 20 : 10, words.size());
+        ASSERT_EQ(words, buffer_to_vector_of_strings(*bp[1]));
+
+        set<char> blocks;
+        for (auto& w : words) {
+            blocks.insert(w[0]);
+        }
+        ASSERT_EQ(i < 6 ? 4 : 2, blocks.size());
+        ASSERT_EQ(sorted(words), false);
+
+        // the first block's worth of records comes from several blocks
+        set<char> first;
+        for (int j = 0; j < 5; ++j) {
+            first.insert(words[j][0]);
+        }
+        ASSERT_GT(first.size(), 1);
+
+        epoch.insert(epoch.end(), words.begin(), words.end());
+    }
+    ASSERT_EQ(mbl->objectCount(), epoch.size());
+    assert_vector_unique(epoch);
+}
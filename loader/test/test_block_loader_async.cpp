@@ -0,0 +1,90 @@
+/*
+ Copyright 2016 Nervana Systems Inc.
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include "gtest/gtest.h"
+
+#include "helpers.hpp"
+#include "batch_iterator.hpp"
+#include "block_loader_async.hpp"
+#include "block_iterator_sequential.hpp"
+#include "block_iterator_shuffled.hpp"
+
+using namespace std;
+using namespace nervana;
+
+vector<string> read_words(shared_ptr<block_iterator> bi, int batch_size, int batch_count) {
+    // read `batch_count` minibatches and return every datum read, in order
+    batch_iterator mi(bi, batch_size);
+    buffer_in_array bp(2);
+
+    for(int i = 0; i < batch_count; ++i) {
+        mi.read(bp);
+    }
+
+    vector<string> words_a = buffer_to_vector_of_strings(*bp[0]);
+    vector<string> words_b = buffer_to_vector_of_strings(*bp[1]);
+    for (uint i=0; i<words_a.size(); ++i) {
+        EXPECT_EQ(words_a[i], words_b[i]);
+    }
+    return words_a;
+}
+
+TEST(block_loader_async, sequential) {
+    // reading through several reader threads must not change the order
+    // blocks come out in, across epoch boundaries too
+    auto mbl   = make_shared<block_loader_alphabet>(3);
+    auto async = make_shared<block_loader_async>(mbl, 4, 5);
+
+    auto expected = read_words(make_shared<block_iterator_sequential>(mbl), 13, 15);
+    auto words    = read_words(make_shared<block_iterator_sequential>(async), 13, 15);
+
+    ASSERT_EQ(words.size(), 13 * 15);
+    ASSERT_EQ(words, expected);
+}
+
+TEST(block_loader_async, shuffled) {
+    auto mbl   = make_shared<block_loader_alphabet>(3);
+    auto async = make_shared<block_loader_async>(mbl, 3, 8);
+
+    auto expected = read_words(make_shared<block_iterator_shuffled>(mbl, 7), 13, 15);
+    auto words    = read_words(make_shared<block_iterator_shuffled>(async, 7), 13, 15);
+
+    ASSERT_EQ(words.size(), 13 * 15);
+    ASSERT_EQ(words, expected);
+}
+
+TEST(block_loader_async, reset) {
+    // resetting mid epoch abandons the blocks which were prefetched
+    auto mbl   = make_shared<block_loader_alphabet>(5);
+    auto async = make_shared<block_loader_async>(mbl, 2, 4);
+
+    block_iterator_shuffled expected_it(mbl, 3);
+    block_iterator_shuffled async_it(async, 3);
+    buffer_in_array expected(2);
+    buffer_in_array bp(2);
+
+    for (int i = 0; i < 3; ++i) {
+        expected_it.read(expected);
+        async_it.read(bp);
+    }
+    expected_it.reset();
+    async_it.reset();
+    for (int i = 0; i < 7; ++i) {
+        expected_it.read(expected);
+        async_it.read(bp);
+    }
+
+    ASSERT_EQ(buffer_to_vector_of_strings(*bp[0]), buffer_to_vector_of_strings(*expected[0]));
+}
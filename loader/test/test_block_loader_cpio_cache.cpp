@@ -14,9 +14,11 @@
 */
 
 #include <random>
+#include <sys/stat.h>
 
 #include "gtest/gtest.h"
 #include "block_loader_cpio_cache.hpp"
+#include "cpio.hpp"
 
 using namespace std;
 using namespace nervana;
@@ -27,7 +29,7 @@ string load_string(block_loader_cpio_cache cache) {
 
     cache.loadBlock(bp, 1);
 
-    vector<char>& x = bp[0]->get_item(0);
+    span x = bp[0]->get_item(0);
     string str(x.data(), x.size());
     return str;
 }
@@ -74,3 +76,192 @@ TEST(block_loader_cpio_cache, differnt_hash) {
         load_string(make_cache("/tmp", block_loader_random::randomString(), "version123"))
     );
 }
+
+TEST(block_loader_cpio_cache, mapped_reader) {
+    // items read through the mapping must stay valid after the reader closes
+    string fileName = "/tmp/" + block_loader_random::randomString() + ".cpio";
+    buffer_in_array src(2);
+    for (int i = 0; i < 3; ++i) {
+        string datum = "datum" + to_string(i) + string(i, 'x');
+        string target = "t" + to_string(i);
+        src[0]->add_item(vector<char>(datum.begin(), datum.end()));
+        src[1]->add_item(vector<char>(target.begin(), target.end()));
+    }
+    cpio::file_writer writer;
+    writer.open(fileName);
+    writer.write_all_records(src);
+    writer.close();
+
+    buffer_in_array dest(2);
+    {
+        cpio::mapped_reader reader;
+        ASSERT_TRUE(reader.open(fileName));
+        ASSERT_EQ(3, reader.itemCount());
+        for (int i = 0; i < reader.itemCount(); ++i) {
+            reader.read(*dest[0]);
+            reader.read(*dest[1]);
+        }
+        ASSERT_THROW(reader.read(*dest[0]), std::exception);
+    }
+    remove(fileName.c_str());
+
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 2; ++j) {
+            span expected = src[j]->get_item(i);
+            span actual = dest[j]->get_item(i);
+            ASSERT_EQ(string(expected.data(), expected.size()),
+                      string(actual.data(), actual.size()));
+        }
+    }
+
+    cpio::mapped_reader missing;
+    ASSERT_FALSE(missing.open(fileName));
+}
+
+TEST(block_loader_cpio_cache, write_behind) {
+    // blocks queued for writing are served from memory and are on disk
+    // once the cache that queued them is gone
+    string hash = block_loader_random::randomString();
+    string first;
+    {
+        block_loader_cpio_cache cache("/tmp", hash, "version123",
+                                      make_shared<block_loader_random>(1), 1);
+        first = load_string(cache);
+        ASSERT_EQ(first, load_string(cache));
+    }
+    ASSERT_EQ(first, load_string(make_cache("/tmp", hash, "version123")));
+}
+
+namespace {
+    // block_loader_alphabet that counts what the cache asks it for
+    class counting_loader : public block_loader_alphabet {
+    public:
+        counting_loader(uint block_size) : block_loader_alphabet(block_size) {}
+        void loadBlock(buffer_in_array& dest, uint block_num) override {
+            ++blocks;
+            block_loader_alphabet::loadBlock(dest, block_num);
+        }
+        int blocks = 0;
+    };
+}
+
+TEST(block_loader_cpio_cache, load_record) {
+    // the first record of a block that isn't cached loads and caches the
+    // whole block, the rest of its records are mapped from the cache file
+    string hash = block_loader_random::randomString();
+    string dir = "/tmp/" + hash + "_version123";
+    auto loader = make_shared<counting_loader>(4);
+    block_loader_cpio_cache cache("/tmp", hash, "version123", loader, 0);
+
+    buffer_in_array missed(2);
+    cache.loadRecord(missed, 6);
+    ASSERT_EQ(1, missed[0]->get_item_count());
+    span word = missed[0]->get_item(0);
+    ASSERT_EQ("Bc", string(word.data(), word.size()));
+    struct stat stats;
+    ASSERT_EQ(0, stat((dir + "/1-4.cpio").c_str(), &stats));
+    ASSERT_EQ(1, loader->blocks);
+
+    buffer_in_array block(2);
+    cache.loadBlock(block, 1);
+    for (int j = 0; j < 4; ++j) {
+        buffer_in_array record(2);
+        cache.loadRecord(record, 4 + j);
+        for (int i = 0; i < 2; ++i) {
+            ASSERT_EQ(1, record[i]->get_item_count());
+            span expected = block[i]->get_item(j);
+            span actual = record[i]->get_item(0);
+            ASSERT_EQ(string(expected.data(), expected.size()),
+                      string(actual.data(), actual.size()));
+        }
+    }
+    ASSERT_EQ(1, loader->blocks);
+}
+
+static void load(block_loader_cpio_cache& cache, uint block_num) {
+    buffer_in_array dest(2);
+    cache.loadBlock(dest, block_num);
+}
+
+static bool cached(const string& dir, uint block_num) {
+    struct stat stats;
+    return stat((dir + "/" + to_string(block_num) + "-1.cpio").c_str(), &stats) == 0;
+}
+
+static string make_root() {
+    // eviction looks at every cache under the root, so give each test its own
+    string root = "/tmp/" + block_loader_random::randomString();
+    mkdir(root.c_str(), 0755);
+    return root;
+}
+
+TEST(block_loader_cpio_cache, eviction) {
+    string root = make_root();
+    string hash = block_loader_random::randomString();
+    string dir = root + "/" + hash + "_version123";
+    auto loader = make_shared<block_loader_alphabet>(1);
+
+    // measure one block file, all of them are the same size
+    size_t blockBytes;
+    {
+        block_loader_cpio_cache cache(root, hash, "version123", loader);
+        load(cache, 0);
+        struct stat stats;
+        ASSERT_EQ(stat((dir + "/0-1.cpio").c_str(), &stats), 0);
+        blockBytes = stats.st_size;
+    }
+
+    // room for two blocks.  Using block 0 again makes 1 the oldest.
+    {
+        block_loader_cpio_cache cache(root, hash, "version123", loader, 0, blockBytes * 2);
+        load(cache, 1);
+        load(cache, 0);
+        load(cache, 2);
+        ASSERT_TRUE(cached(dir, 0));
+        ASSERT_FALSE(cached(dir, 1));
+        ASSERT_TRUE(cached(dir, 2));
+    }
+
+    // the order survives in the index
+    {
+        block_loader_cpio_cache cache(root, hash, "version123", loader, 0, blockBytes * 2);
+        load(cache, 3);
+        ASSERT_FALSE(cached(dir, 0));
+        ASSERT_TRUE(cached(dir, 2));
+        ASSERT_TRUE(cached(dir, 3));
+    }
+}
+
+TEST(block_loader_cpio_cache, shared_budget) {
+    // caches of different datasets under one root share its budget
+    string root = make_root();
+    string hash1 = block_loader_random::randomString();
+    string hash2 = block_loader_random::randomString();
+    string dir1 = root + "/" + hash1 + "_version123";
+    string dir2 = root + "/" + hash2 + "_version123";
+    auto loader = make_shared<block_loader_alphabet>(1);
+
+    size_t blockBytes;
+    {
+        block_loader_cpio_cache cache(root, hash1, "version123", loader);
+        load(cache, 0);
+        struct stat stats;
+        ASSERT_EQ(stat((dir1 + "/0-1.cpio").c_str(), &stats), 0);
+        blockBytes = stats.st_size;
+    }
+
+    block_loader_cpio_cache cache1(root, hash1, "version123", loader, 0, blockBytes * 2);
+    load(cache1, 1);
+    load(cache1, 0);
+    ASSERT_TRUE(cached(dir1, 0));
+    ASSERT_TRUE(cached(dir1, 1));
+
+    {
+        // block 1 of the first cache was used least recently
+        block_loader_cpio_cache cache2(root, hash2, "version123", loader, 0, blockBytes * 2);
+        load(cache2, 0);
+        ASSERT_TRUE(cached(dir1, 0));
+        ASSERT_FALSE(cached(dir1, 1));
+        ASSERT_TRUE(cached(dir2, 0));
+    }
+}
@@ -118,3 +118,41 @@ TEST(blocked_file_loader, subset_object_count) {
 
     ASSERT_EQ(blf.objectCount(), 2 + 2 + 1);
 }
+
+TEST(blocked_file_loader, shards) {
+    // 10 objects in blocks of 4 are blocks 0 and 2 for the first of two
+    // shards, with 4 and 2 objects, and block 1 for the second
+    auto manifest = make_shared<nervana::manifest_csv>(tmp_manifest_file(10, {16, 16}), false);
+    block_loader_file first(manifest, 1.0, 4, 2, 0);
+    block_loader_file second(manifest, 1.0, 4, 2, 1);
+
+    EXPECT_EQ(3, first.blockCount());
+    EXPECT_EQ(2, first.shardBlockCount());
+    EXPECT_EQ(6, first.shardObjectCount());
+    EXPECT_EQ(2, first.shardBlock(1));
+    EXPECT_EQ(1, second.shardBlockCount());
+    EXPECT_EQ(4, second.shardObjectCount());
+
+    buffer_in_array bp(2);
+    second.loadBlock(bp, 1);
+    EXPECT_EQ(4, bp[0]->get_item_count());
+    EXPECT_THROW(second.loadBlock(bp, 2), runtime_error);
+}
+
+TEST(blocked_file_loader, equal_shards) {
+    // 23 objects in blocks of 2 are 11 full blocks and a partial one.  With
+    // equal shards each of 3 shards reads 3 full blocks and drops the rest.
+    auto manifest = make_shared<nervana::manifest_csv>(tmp_manifest_file(23, {16, 16}), false);
+    for (uint i = 0; i < 3; ++i) {
+        block_loader_file uneven(manifest, 1.0, 2, 3, i);
+        block_loader_file equal(manifest, 1.0, 2, 3, i, true);
+        EXPECT_EQ(i < 2 ? 8 : 7, uneven.shardObjectCount());
+        EXPECT_EQ(3, equal.shardBlockCount());
+        EXPECT_EQ(6, equal.shardObjectCount());
+        EXPECT_TRUE(equal.fullBlock(equal.shardBlock(equal.shardBlockCount() - 1)));
+    }
+
+    // a single shard has nothing to equalize
+    block_loader_file whole(manifest, 1.0, 2, 1, 0, true);
+    EXPECT_EQ(23, whole.shardObjectCount());
+}
@@ -0,0 +1,188 @@
+/*
+ Copyright 2016 Nervana Systems Inc.
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include <fstream>
+#include <random>
+#include <unistd.h>
+
+#include "gtest/gtest.h"
+#include "cpio.hpp"
+
+using namespace std;
+using namespace nervana;
+
+static string tmp_cpio_name() {
+    static int count = 0;
+    return "/tmp/test_cpio_" + to_string(getpid()) + "_" + to_string(count++) + ".cpio";
+}
+
+static string item(int record, int element) {
+    return "record" + to_string(record) + "." + to_string(element) + string(record, '#');
+}
+
+static string str(span s) {
+    return string(s.data(), s.size());
+}
+
+static string write_v2(int records) {
+    string fileName = tmp_cpio_name();
+    cpio::file_writer writer;
+    writer.open(fileName);
+    for (int i = 0; i < records; i++) {
+        for (int j = 0; j < 2; j++) {
+            string s = item(i, j);
+            writer.write_record_element(s.data(), s.size(), j);
+        }
+        writer.increment_record_count();
+    }
+    writer.close();
+    return fileName;
+}
+
+static string write_v1(int records) {
+    // the layout written before files carried an index
+    string fileName = tmp_cpio_name();
+    ofstream ofs(fileName, ostream::binary);
+    cpio::record_header rh;
+    rh.write(ofs, 64, "cpiohdr");
+    char header[64] = {0};
+    uint32_t version = 1;
+    uint32_t count = records;
+    memcpy(header, MAGIC_STRING, 4);
+    memcpy(header + 4, &version, 4);
+    memcpy(header + 8, &version, 4);
+    memcpy(header + 20, &count, 4);
+    ofs.write(header, sizeof(header));
+    for (int i = 0; i < records; i++) {
+        for (int j = 0; j < 2; j++) {
+            string s = item(i, j);
+            rh.write(ofs, s.size(), "rec");
+            ofs.write(s.data(), s.size());
+            if (s.size() % 2) {
+                ofs.put(0);
+            }
+        }
+    }
+    char trailer[16] = {0};
+    rh.write(ofs, 16, "cpiotlr");
+    ofs.write(trailer, sizeof(trailer));
+    rh.write(ofs, 0, CPIO_FOOTER);
+    return fileName;
+}
+
+TEST(cpio, random_access) {
+    string fileName = write_v2(5);
+
+    cpio::file_reader reader;
+    ASSERT_TRUE(reader.open(fileName));
+    ASSERT_TRUE(reader.indexed());
+    ASSERT_EQ(5, reader.itemCount());
+    ASSERT_EQ(2, reader.elementCount());
+    ASSERT_TRUE(reader.validate());
+
+    buffer_in b;
+    reader.read(b, 3, 1);
+    reader.read(b, 0, 0);
+    reader.read(b, 4, 1);
+    ASSERT_EQ(item(3, 1), str(b.get_item(0)));
+    ASSERT_EQ(item(0, 0), str(b.get_item(1)));
+    ASSERT_EQ(item(4, 1), str(b.get_item(2)));
+    ASSERT_THROW(reader.read(b, 5, 0), std::exception);
+    reader.close();
+
+    cpio::mapped_reader mapped;
+    ASSERT_TRUE(mapped.open(fileName));
+    ASSERT_TRUE(mapped.validate());
+    buffer_in m;
+    mapped.read(m, 2, 0);
+    mapped.read(m);
+    ASSERT_EQ(item(2, 0), str(m.get_item(0)));
+    ASSERT_EQ(item(0, 0), str(m.get_item(1)));
+
+    remove(fileName.c_str());
+}
+
+TEST(cpio, sequential) {
+    // version 2 files still read front to back
+    string fileName = write_v2(3);
+
+    cpio::file_reader reader;
+    ASSERT_TRUE(reader.open(fileName));
+    buffer_in b;
+    for (int i = 0; i < reader.itemCount() * 2; i++) {
+        reader.read(b);
+    }
+    for (int i = 0; i < 3; i++) {
+        ASSERT_EQ(item(i, 0), str(b.get_item(i * 2)));
+        ASSERT_EQ(item(i, 1), str(b.get_item(i * 2 + 1)));
+    }
+
+    remove(fileName.c_str());
+}
+
+TEST(cpio, checksum) {
+    string fileName = write_v2(3);
+
+    // flip one byte of the last record
+    {
+        fstream fs(fileName, ios::in | ios::out | ios::binary);
+        string last = item(2, 1);
+        fs.seekg(0, fs.end);
+        string contents(fs.tellg(), 0);
+        fs.seekg(0);
+        fs.read(&contents[0], contents.size());
+        size_t pos = contents.find(last);
+        ASSERT_NE(string::npos, pos);
+        fs.seekp(pos);
+        fs.put('R');
+    }
+
+    cpio::file_reader reader;
+    ASSERT_TRUE(reader.open(fileName));
+    ASSERT_FALSE(reader.validate());
+
+    cpio::mapped_reader mapped;
+    ASSERT_TRUE(mapped.open(fileName));
+    ASSERT_FALSE(mapped.validate());
+
+    remove(fileName.c_str());
+}
+
+TEST(cpio, version1) {
+    string fileName = write_v1(4);
+
+    cpio::file_reader reader;
+    ASSERT_TRUE(reader.open(fileName));
+    ASSERT_FALSE(reader.indexed());
+    ASSERT_TRUE(reader.validate());
+    ASSERT_EQ(4, reader.itemCount());
+    buffer_in b;
+    for (int i = 0; i < reader.itemCount() * 2; i++) {
+        reader.read(b);
+    }
+    for (int i = 0; i < 4; i++) {
+        ASSERT_EQ(item(i, 0), str(b.get_item(i * 2)));
+        ASSERT_EQ(item(i, 1), str(b.get_item(i * 2 + 1)));
+    }
+    reader.close();
+
+    cpio::mapped_reader mapped;
+    ASSERT_TRUE(mapped.open(fileName));
+    buffer_in m;
+    mapped.read(m, 3, 1);
+    ASSERT_EQ(item(3, 1), str(m.get_item(0)));
+
+    remove(fileName.c_str());
+}
@@ -0,0 +1,56 @@
+/*
+ Copyright 2016 Nervana Systems Inc.
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include <vector>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "cpu.hpp"
+
+using namespace std;
+using namespace nervana;
+
+TEST(cpu, parse_list)
+{
+    EXPECT_EQ((vector<int>{0, 1, 2, 3, 8, 10, 11}), cpu::parse_list("0-3,8,10-11"));
+    EXPECT_EQ((vector<int>{5}), cpu::parse_list(" 5 "));
+    EXPECT_TRUE(cpu::parse_list("").empty());
+    EXPECT_THROW(cpu::parse_list("3-1"), invalid_argument);
+    EXPECT_THROW(cpu::parse_list("a,b"), invalid_argument);
+    EXPECT_THROW(cpu::parse_list("-1"), invalid_argument);
+}
+
+TEST(cpu, available)
+{
+    // never more than the affinity mask allows, and never zero
+    int available = cpu::available();
+    EXPECT_GE(available, 1);
+    EXPECT_LE(available, (int)cpu::allowed().size());
+}
+
+TEST(cpu, pin)
+{
+    vector<int> cpus{cpu::allowed()[0]};
+    vector<int> seen;
+    thread t([&]() {
+        cpu::pin(cpus);
+        seen = cpu::allowed();
+    });
+    t.join();
+#ifdef __linux__
+    EXPECT_EQ(cpus, seen);
+#endif
+}
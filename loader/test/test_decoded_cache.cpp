@@ -0,0 +1,107 @@
+/*
+ Copyright 2016 Nervana Systems Inc.
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include <unistd.h>
+
+#include "gtest/gtest.h"
+#include "decoded_cache.hpp"
+#include "block_loader.hpp"
+
+using namespace std;
+using namespace nervana;
+
+TEST(decoded_cache, shared) {
+    // two caches opened on the same file see each other's records, like
+    // two processes would
+    string hash = block_loader_random::randomString();
+    decoded_cache writer("/tmp", hash, 10, {4, 2});
+    decoded_cache reader("/tmp", hash, 10, {4, 2});
+
+    buffer_out_array out({4, 2}, 3);
+    memcpy(out[0]->get_item(1), "abcd", 4);
+    memcpy(out[1]->get_item(1), "ef", 2);
+
+    ASSERT_FALSE(reader.load(7, out, 0));
+    writer.store(7, out, 1);
+
+    // a record is only stored once
+    memcpy(out[0]->get_item(1), "xxxx", 4);
+    reader.store(7, out, 1);
+
+    ASSERT_TRUE(reader.load(7, out, 2));
+    ASSERT_EQ(string(out[0]->get_item(2), 4), "abcd");
+    ASSERT_EQ(string(out[1]->get_item(2), 2), "ef");
+
+    // records without a known position are never cached
+    writer.store(-1, out, 1);
+    ASSERT_FALSE(reader.load(-1, out, 2));
+    ASSERT_FALSE(reader.load(10, out, 2));
+
+    unlink(("/tmp/" + hash + ".decoded").c_str());
+}
+
+TEST(decoded_cache, mismatch) {
+    string hash = block_loader_random::randomString();
+    decoded_cache cache("/tmp", hash, 10, {4, 2});
+    ASSERT_THROW(decoded_cache("/tmp", hash, 10, {4, 4}), std::runtime_error);
+    unlink(("/tmp/" + hash + ".decoded").c_str());
+}
+
+TEST(decoded_cache, randomized) {
+    nlohmann::json image = {{"height", 32}, {"width", 32}, {"scale", {0.5, 0.5}},
+                            {"lighting", {0.0, 0.0}}, {"flip_enable", false}};
+    ASSERT_FALSE(decoded_cache::randomized({{"type", "image,label"}, {"image", image}}));
+    ASSERT_FALSE(decoded_cache::randomized({{"type", "audio"}, {"audio", {{"max_duration", "1 sec"}}}}));
+
+    nlohmann::json random = image;
+    random["scale"] = {0.5, 1.0};
+    ASSERT_TRUE(decoded_cache::randomized({{"image", random}}));
+    ASSERT_TRUE(decoded_cache::randomized({{"video", {{"frame", random}}}}));
+
+    for (auto& augmentation : {nlohmann::json{{"horizontal_distortion", {0.75, 1.33}}},
+                               nlohmann::json{{"angle", {-10, 10}}},
+                               nlohmann::json{{"lighting", {0.0, 0.1}}},
+                               nlohmann::json{{"photometric", {-0.1, 0.1}}},
+                               nlohmann::json{{"flip_enable", true}},
+                               nlohmann::json{{"center", false}}}) {
+        random = image;
+        for (auto it = augmentation.begin(); it != augmentation.end(); ++it) {
+            random[it.key()] = it.value();
+        }
+        ASSERT_TRUE(decoded_cache::randomized({{"image", random}})) << augmentation.dump();
+    }
+}
+
+TEST(decoded_cache, randomized_audio) {
+    nlohmann::json audio = {{"max_duration", "1 sec"}, {"frame_length", "25 milliseconds"},
+                            {"frame_stride", "10 milliseconds"}, {"add_noise_probability", 0.0},
+                            {"noise_level", {0.0, 0.5}}, {"time_scale_fraction", {1.0, 1.0}}};
+    ASSERT_FALSE(decoded_cache::randomized({{"type", "audio,label"}, {"audio", audio}}));
+
+    nlohmann::json noisy = audio;
+    noisy["add_noise_probability"] = 0.5;
+    ASSERT_TRUE(decoded_cache::randomized({{"type", "audio,label"}, {"audio", noisy}}));
+
+    nlohmann::json stretched = audio;
+    stretched["time_scale_fraction"] = {0.9, 1.1};
+    ASSERT_TRUE(decoded_cache::randomized({{"type", "audio,transcription"}, {"audio", stretched}}));
+}
+
+TEST(decoded_cache, randomized_localization) {
+    // anchors are sampled at random however the image is transformed
+    nlohmann::json image = {{"height", 32}, {"width", 32}};
+    ASSERT_FALSE(decoded_cache::randomized({{"type", "image,boundingbox"}, {"image", image}}));
+    ASSERT_TRUE(decoded_cache::randomized({{"type", "image,localization"}, {"image", image}}));
+}
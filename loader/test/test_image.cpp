@@ -443,6 +443,36 @@ TEST(image,convert_split) {
     }
 }
 
+TEST(image,convert_8u)
+{
+    // the direct kernels match convertTo followed by mixChannels for every
+    // output type, with a width that leaves a partial SIMD block per row
+    cv::Mat input(7, 37, CV_8UC3);
+    cv::randu(input, 0, 256);
+    for (int cv_type : {CV_8U, CV_8S, CV_16U, CV_16S, CV_32S, CV_32F, CV_64F}) {
+        for (bool channel_major : {false, true}) {
+            size_t size = input.total() * input.channels() * CV_ELEM_SIZE1(cv_type);
+            vector<char> expected(size);
+            vector<char> actual(size);
+
+            vector<cv::Mat> source{input};
+            vector<cv::Mat> target;
+            vector<int>     from_to{0, 0, 1, 1, 2, 2};
+            if (channel_major) {
+                for (int ch = 0; ch < 3; ch++) {
+                    target.emplace_back(input.size(), cv_type, &expected[ch * size / 3]);
+                }
+            } else {
+                target.emplace_back(input.size(), CV_MAKETYPE(cv_type, 3), &expected[0]);
+            }
+            image::convert_mix_channels(source, target, from_to);
+
+            image::convert_8u(input, &actual[0], cv_type, channel_major);
+            EXPECT_EQ(expected, actual) << "type " << cv_type << " channel_major " << channel_major;
+        }
+    }
+}
+
 TEST(image, multi_crop) {
     auto indexed = generate_indexed_image();  // 256 x 256
     vector<unsigned char> img;
@@ -717,6 +747,125 @@ TEST(image,transform)
     }
 }
 
+TEST(image,reduced_decode)
+{
+    // a JPEG decoded at a reduced size gets the same params, in source
+    // pixels, and nearly the same output as one decoded at full size
+    vector<char> image_data = read_file_contents(CURDIR"/test_data/img_2112_70.jpg");
+    nlohmann::json js = {
+                            {"height",32},
+                            {"width",32},
+                            {"channels",3},
+                            {"channel_major",false},
+                            {"flip_enable",false}
+                        };
+    image::config full_cfg{js};
+    js["reduced_decode"] = true;
+    image::config reduced_cfg{js};
+
+    image::extractor full_extractor{full_cfg};
+    image::extractor reduced_extractor{reduced_cfg};
+    auto full = full_extractor.extract(image_data.data(), image_data.size());
+    auto reduced = reduced_extractor.extract(image_data.data(), image_data.size());
+    EXPECT_EQ(full->get_image_size(), reduced->get_source_size());
+    EXPECT_EQ(60, reduced->get_image_size().width);
+    EXPECT_EQ(45, reduced->get_image_size().height);
+
+    image::param_factory full_factory(full_cfg);
+    image::param_factory reduced_factory(reduced_cfg);
+    auto full_params = full_factory.make_params(full);
+    auto reduced_params = reduced_factory.make_params(reduced);
+    EXPECT_EQ(full_params->cropbox, reduced_params->cropbox);
+
+    image::transformer full_transformer{full_cfg};
+    image::transformer reduced_transformer{reduced_cfg};
+    cv::Mat a = full_transformer.transform(full_params, full)->get_image(0);
+    cv::Mat b = reduced_transformer.transform(reduced_params, reduced)->get_image(0);
+    ASSERT_EQ(a.size(), b.size());
+    EXPECT_LT(cv::norm(a, b, cv::NORM_L1) / (a.total() * a.channels()), 8.0);
+}
+
+TEST(image,reduced_decode_exif_rotated)
+{
+    // imdecode honours the EXIF orientation, so a JPEG tagged as rotated
+    // decodes with width and height swapped relative to its frame header
+    cv::Mat source(480, 640, CV_8UC3);
+    for (int row = 0; row < source.rows; row++) {
+        for (int col = 0; col < source.cols; col++) {
+            source.at<cv::Vec3b>(row, col) = cv::Vec3b(col % 256, row % 256, (row + col) % 256);
+        }
+    }
+    vector<uchar> encoded;
+    cv::imencode(".jpg", source, encoded);
+
+    // APP1 segment holding a big endian TIFF IFD with orientation 6
+    const uchar exif[] = {
+        0xFF, 0xE1, 0x00, 0x22, 'E', 'x', 'i', 'f', 0x00, 0x00,
+        'M', 'M', 0x00, 0x2A, 0x00, 0x00, 0x00, 0x08,
+        0x00, 0x01,
+        0x01, 0x12, 0x00, 0x03, 0x00, 0x00, 0x00, 0x01, 0x00, 0x06, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00
+    };
+    vector<char> image_data(encoded.begin(), encoded.begin() + 2);
+    image_data.insert(image_data.end(), exif, exif + sizeof(exif));
+    image_data.insert(image_data.end(), encoded.begin() + 2, encoded.end());
+
+    nlohmann::json js = {
+                            {"height",32},
+                            {"width",32},
+                            {"channels",3},
+                            {"channel_major",false},
+                            {"flip_enable",false}
+                        };
+    image::config full_cfg{js};
+    js["reduced_decode"] = true;
+    image::config reduced_cfg{js};
+
+    image::extractor full_extractor{full_cfg};
+    image::extractor reduced_extractor{reduced_cfg};
+    auto full = full_extractor.extract(image_data.data(), image_data.size());
+    auto reduced = reduced_extractor.extract(image_data.data(), image_data.size());
+    EXPECT_EQ(full->get_image_size(), reduced->get_source_size());
+    EXPECT_LT(reduced->get_image_size().area(), full->get_image_size().area());
+
+    image::param_factory full_factory(full_cfg);
+    image::param_factory reduced_factory(reduced_cfg);
+    auto full_params = full_factory.make_params(full);
+    auto reduced_params = reduced_factory.make_params(reduced);
+    EXPECT_EQ(full_params->cropbox, reduced_params->cropbox);
+
+    image::transformer full_transformer{full_cfg};
+    image::transformer reduced_transformer{reduced_cfg};
+    cv::Mat a = full_transformer.transform(full_params, full)->get_image(0);
+    cv::Mat b = reduced_transformer.transform(reduced_params, reduced)->get_image(0);
+    ASSERT_EQ(a.size(), b.size());
+    EXPECT_LT(cv::norm(a, b, cv::NORM_L1) / (a.total() * a.channels()), 8.0);
+}
+
+TEST(image,rotate_crop_resize)
+{
+    // the single pass warp matches rotate, crop, resize and flip done one
+    // after another, both when enlarging and when shrinking the crop
+    cv::Mat input = cv::imdecode(read_file_contents(CURDIR"/test_data/img_2112_70.jpg"), CV_LOAD_IMAGE_COLOR);
+    cv::Rect cropbox(100, 60, 240, 200);
+    for (cv::Size2i size : {cv::Size2i(300, 250), cv::Size2i(60, 50)}) {
+        for (bool flip : {false, true}) {
+            cv::Mat rotated;
+            image::rotate(input, rotated, 15);
+            cv::Mat expected;
+            image::resize(rotated(cropbox), expected, size);
+            if (flip) {
+                cv::flip(expected, expected, 1);
+            }
+
+            cv::Mat actual;
+            image::rotate_crop_resize(input, actual, 15, cropbox, size, flip);
+            ASSERT_EQ(expected.size(), actual.size());
+            EXPECT_LT(cv::norm(expected, actual, cv::NORM_L1) / (actual.total() * actual.channels()), 4.0);
+        }
+    }
+}
+
 TEST(image,config_bad_scale)
 {
     int height = 128;
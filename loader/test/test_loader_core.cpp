@@ -0,0 +1,171 @@
+/*
+ Copyright 2016 Nervana Systems Inc.
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include <fstream>
+#include <thread>
+#include <numeric>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+#include "gtest/gtest.h"
+#include "csv_manifest_maker.hpp"
+#include "loader_core.hpp"
+
+using namespace std;
+using namespace nervana;
+
+namespace {
+    // a manifest of small images, one per label
+    string image_manifest(const vector<int>& labels)
+    {
+        string manifest = tmp_filename();
+        ofstream m(manifest);
+        for (int i = 0; i < labels.size(); i++) {
+            string image = tmp_filename() + ".jpg";
+            string label = tmp_filename();
+            cv::imwrite(image, cv::Mat(40, 40, CV_8UC3, cv::Scalar(i, 2 * i, 3 * i)));
+            ofstream(label) << labels[i];
+            m << image << "," << label << "\n";
+        }
+        return manifest;
+    }
+
+    // a manifest of `count` small images, labelled with their record number
+    string image_manifest(int count)
+    {
+        vector<int> labels(count);
+        iota(labels.begin(), labels.end(), 0);
+        return image_manifest(labels);
+    }
+}
+
+TEST(loader_core, next_release) {
+    nlohmann::json js = {{"type", "image,label"},
+                         {"image", {{"height", 32}, {"width", 32}, {"channels", 3}}},
+                         {"label", {{"binary", false}}},
+                         {"manifest_filename", image_manifest(10)},
+                         {"minibatch_size", 4}};
+    loader_core core(js.dump());
+    ASSERT_EQ(0, core.start());
+    ASSERT_EQ(2, core.oshapes().size());
+
+    // minibatches run on past the end of the epoch
+    vector<const buffer_out*> outputs;
+    for (int batch = 0; batch < 5; batch++) {
+        int index = core.next(outputs);
+        EXPECT_EQ(batch % core.buffer_count(), index);
+        ASSERT_EQ(2, outputs.size());
+        EXPECT_EQ(4, outputs[0]->get_item_count());
+        for (int i = 0; i < 4; i++) {
+            EXPECT_EQ((batch * 4 + i) % 10, unpack<int>(outputs[1]->get_item(i)));
+        }
+
+        // the buffers are held until they are released
+        EXPECT_THROW(core.next(outputs), runtime_error);
+        core.release();
+    }
+
+    // stopping with a minibatch held gives it back
+    core.next(outputs);
+    core.stop();
+}
+
+TEST(loader_core, small_minibatch) {
+    // more threads than records, so several minibatches are decoded at
+    // once.  They still come out whole and in order.
+    nlohmann::json js = {{"type", "image,label"},
+                         {"image", {{"height", 32}, {"width", 32}, {"channels", 3}}},
+                         {"label", {{"binary", false}}},
+                         {"manifest_filename", image_manifest(10)},
+                         {"minibatch_size", 2},
+                         {"decode_thread_count", 8}};
+    loader_core core(js.dump());
+    ASSERT_EQ(0, core.start());
+    EXPECT_EQ(5, core.buffer_count());
+
+    vector<const buffer_out*> outputs;
+    for (int batch = 0; batch < 20; batch++) {
+        core.next(outputs);
+        for (int i = 0; i < 2; i++) {
+            EXPECT_EQ((batch * 2 + i) % 10, unpack<int>(outputs[1]->get_item(i)));
+        }
+        core.release();
+    }
+    core.stop();
+}
+
+TEST(loader_core, reset) {
+    nlohmann::json js = {{"type", "image,label"},
+                         {"image", {{"height", 32}, {"width", 32}, {"channels", 3}}},
+                         {"label", {{"binary", false}}},
+                         {"manifest_filename", image_manifest(10)},
+                         {"minibatch_size", 4}};
+    loader_core core(js.dump());
+    ASSERT_EQ(0, core.start());
+
+    // every epoch starts from the first record, whether the reset comes
+    // with a minibatch held, straight after another reset or after the
+    // prefetched minibatches have all been decoded
+    vector<const buffer_out*> outputs;
+    for (int epoch = 0; epoch < 4; epoch++) {
+        for (int batch = 0; batch < epoch + 1; batch++) {
+            core.next(outputs);
+            for (int i = 0; i < 4; i++) {
+                EXPECT_EQ((batch * 4 + i) % 10, unpack<int>(outputs[1]->get_item(i)));
+            }
+            if (epoch != 1) {
+                core.release();
+            }
+        }
+        if (epoch == 2) {
+            core.reset();
+        } else if (epoch == 3) {
+            this_thread::sleep_for(chrono::milliseconds(100));
+        }
+        core.reset();
+    }
+    core.stop();
+}
+
+TEST(loader_core, balanced) {
+    // eight records of class 0 and two of class 1 are drawn equally often
+    vector<int> labels = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1};
+    nlohmann::json js = {{"type", "image,label"},
+                         {"image", {{"height", 32}, {"width", 32}, {"channels", 3}}},
+                         {"label", {{"binary", false}}},
+                         {"manifest_filename", image_manifest(labels)},
+                         {"minibatch_size", 10},
+                         {"sample_weights", "balanced"}};
+    loader_core core(js.dump());
+    ASSERT_EQ(0, core.start());
+
+    vector<const buffer_out*> outputs;
+    int drawn[2] = {0, 0};
+    for (int batch = 0; batch < 200; batch++) {
+        core.next(outputs);
+        for (int i = 0; i < 10; i++) {
+            ++drawn[unpack<int>(outputs[1]->get_item(i))];
+        }
+        core.release();
+    }
+    core.stop();
+    EXPECT_NEAR(0.5, drawn[1] / 2000.0, 0.05);
+
+    // any other target would put every record in a class of its own
+    js["type"] = "image";
+    js.erase("label");
+    EXPECT_THROW(loader_core(js.dump()), runtime_error);
+}
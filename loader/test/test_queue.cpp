@@ -0,0 +1,107 @@
+/*
+ Copyright 2016 Nervana Systems Inc.
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include <vector>
+#include <thread>
+#include <atomic>
+
+#include "gtest/gtest.h"
+
+#include "spsc_queue.hpp"
+#include "event_count.hpp"
+#include "buffer_pool_out.hpp"
+
+using namespace std;
+using namespace nervana;
+
+TEST(spsc_queue, bounded) {
+    spsc_queue<int> queue(2);
+    int value;
+
+    ASSERT_TRUE(queue.empty());
+    ASSERT_FALSE(queue.try_pop(value));
+    ASSERT_TRUE(queue.try_push(1));
+    ASSERT_TRUE(queue.try_push(2));
+    ASSERT_FALSE(queue.try_push(3));
+
+    ASSERT_TRUE(queue.try_pop(value));
+    ASSERT_EQ(1, value);
+    ASSERT_TRUE(queue.try_push(3));
+    ASSERT_TRUE(queue.try_pop(value));
+    ASSERT_EQ(2, value);
+    ASSERT_TRUE(queue.try_pop(value));
+    ASSERT_EQ(3, value);
+    ASSERT_TRUE(queue.empty());
+}
+
+TEST(spsc_queue, threads) {
+    // values arrive in order with both sides sleeping on event_counts
+    spsc_queue<int> queue(4);
+    event_count not_empty;
+    event_count not_full;
+    const int count = 100000;
+
+    thread producer([&]() {
+        for (int i = 0; i < count; i++) {
+            not_full.wait([&]() { return queue.try_push(i); });
+            not_empty.notify_all();
+        }
+    });
+
+    int value;
+    for (int i = 0; i < count; i++) {
+        not_empty.wait([&]() { return queue.try_pop(value); });
+        not_full.notify_all();
+        ASSERT_EQ(i, value);
+    }
+    producer.join();
+}
+
+TEST(buffer_pool_out, threads) {
+    // reserve, publish and read each on their own thread, as the decode
+    // manager, the finisher and the python thread do
+    buffer_pool_out pool({sizeof(int)}, 1, false, 3);
+    spsc_queue<int> reserved(3);
+    event_count reserved_ready;
+    const int count = 20000;
+
+    thread manager([&]() {
+        for (int i = 0; i < count; i++) {
+            pool.wait_for_non_full();
+            int index = pool.reserve_for_write();
+            *(int*)pool.get(index)[0]->get_item(0) = i;
+            reserved.try_push(index);
+            reserved_ready.notify_all();
+        }
+    });
+    thread finisher([&]() {
+        for (int i = 0; i < count; i++) {
+            int index;
+            reserved_ready.wait([&]() { return reserved.try_pop(index); });
+            pool.advance_write_pos();
+            pool.signal_not_empty();
+        }
+    });
+
+    for (int i = 0; i < count; i++) {
+        pool.wait_for_not_empty();
+        ASSERT_EQ(i, *(int*)pool.get_for_read()[0]->get_item(0));
+        pool.advance_read_pos();
+        pool.signal_not_full();
+    }
+    manager.join();
+    finisher.join();
+    ASSERT_TRUE(pool.empty());
+}
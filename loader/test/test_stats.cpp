@@ -0,0 +1,85 @@
+/*
+ Copyright 2016 Nervana Systems Inc.
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include <vector>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "stats.hpp"
+
+using namespace std;
+using namespace nervana;
+
+namespace {
+    uint64_t count(const char* stage)
+    {
+        auto js = stats::snapshot();
+        return js.count(stage) ? js[stage]["count"].get<uint64_t>() : 0;
+    }
+}
+
+TEST(stats, buckets) {
+    // every value falls in the bucket whose range holds it, and buckets
+    // are never wider than an eighth of their lower bound
+    for (uint64_t ns : {0ull, 1ull, 7ull, 8ull, 9ull, 15ull, 16ull, 17ull, 1000ull, 123456789ull, ~0ull}) {
+        int b = stats::histogram::bucket(ns);
+        ASSERT_LT(b, stats::histogram::buckets);
+        ASSERT_LE(stats::histogram::lower_bound(b), ns);
+        if (b + 1 < stats::histogram::buckets) {
+            ASSERT_GT(stats::histogram::lower_bound(b + 1), ns);
+        }
+    }
+    for (int b = 8; b + 1 < stats::histogram::buckets; b++) {
+        uint64_t lo = stats::histogram::lower_bound(b);
+        ASSERT_LE(stats::histogram::lower_bound(b + 1) - lo, lo / 8);
+    }
+}
+
+TEST(stats, threads) {
+    // records from threads that have exited are kept
+    uint64_t before = count("post_process");
+    vector<thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([]() {
+            for (int i = 0; i < 1000; i++) {
+                stats::record(stats::stage::post_process, 1000 * (i + 1));
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    ASSERT_EQ(before + 4000, count("post_process"));
+
+    auto js = stats::snapshot()["post_process"];
+    if (before == 0) {
+        EXPECT_NEAR(500.5, js["mean_us"].get<double>(), 0.01);
+        EXPECT_NEAR(500, js["p50_us"].get<double>(), 500 / 8.0);
+        EXPECT_NEAR(990, js["p99_us"].get<double>(), 990 / 8.0);
+        EXPECT_EQ(1000, js["max_us"].get<double>());
+    }
+}
+
+TEST(stats, timer) {
+    uint64_t before = count("backend_transfer");
+    {
+        stats::timer timer(stats::stage::backend_transfer);
+    }
+    stats::split split;
+    split.mark(stats::stage::backend_transfer);
+    split.mark(stats::stage::backend_transfer);
+    ASSERT_EQ(before + 3, count("backend_transfer"));
+}
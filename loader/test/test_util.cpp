@@ -397,6 +397,13 @@ TEST(util,unbiased_round)
     EXPECT_EQ(-2, nervana::unbiased_round(-1.5));
 }
 
+TEST(util, hash_string) {
+    // FNV-1a test vectors, so cache names don't change between builds
+    EXPECT_EQ("cbf29ce484222325", nervana::hash_string(""));
+    EXPECT_EQ("af63dc4c8601ec8c", nervana::hash_string("a"));
+    EXPECT_EQ("85944171f73967e8", nervana::hash_string("foobar"));
+}
+
 TEST(DISABLED_util,dump)
 {
     string text = "this is a text string used to test the dump function.";
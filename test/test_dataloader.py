@@ -1,3 +1,4 @@
+import json
 import tempfile
 
 import numpy as np
@@ -163,5 +164,66 @@ def test_loader_reset():
     assert len(list(iter(dl))) == 5
 
 
+class BatchBackend(object):
+    """
+    a backend that copies each minibatch with one consume_batch call
+    """
+    use_pinned_mem = False
+
+    def __init__(self):
+        self.calls = 0
+        self.targets = []
+
+    def consume_batch(self, buf_index, host_tuple, dev_tuple):
+        self.calls += 1
+        for hostlist, devlist in zip(host_tuple, dev_tuple):
+            devlist[buf_index] = hostlist[buf_index].copy()
+        self.targets.append(host_tuple[1][buf_index].copy())
+
+
+def test_loader_consume_batch_deferred():
+    # NOTE: manifest needs to stay in scope until DataLoader has read it.
+    manifest = random_manifest(10)
+    config = generic_config(manifest.name)
+    config['defer_transfer'] = True
+
+    backend = BatchBackend()
+    dl = DataLoader(config, backend)
+
+    # deferred transfers happen in next(), one per minibatch
+    batches = list(iter(dl))
+    assert len(batches) == 5
+    assert backend.calls == 5
+    assert batches[0][0].shape == (2, 2 * 2 * 3)
+
+
+
+def test_loader_state():
+    # NOTE: manifest needs to stay in scope until DataLoader has read it.
+    manifest = random_manifest(10)
+    config = generic_config(manifest.name)
+    config['defer_transfer'] = True
+    config['shuffle_every_epoch'] = True
+    config['macrobatch_size'] = 4
+
+    def targets(backend, dl, count):
+        for _ in range(count):
+            dl.next()
+        return [t.tolist() for t in backend.targets[-count:]]
+
+    # a loader moved to another's state carries on with the same records
+    backend_a = BatchBackend()
+    dl_a = DataLoader(config, backend_a)
+    targets(backend_a, dl_a, 7)
+    state = dl_a.get_state()
+    expected = targets(backend_a, dl_a, 8)
+
+    backend_b = BatchBackend()
+    dl_b = DataLoader(config, backend_b)
+    dl_b.set_state(json.loads(json.dumps(state)))
+    assert targets(backend_b, dl_b, 8) == expected
+    assert dl_b.nbatches == dl_a.nbatches
+
+
 if __name__ == '__main__':
     pytest.main()